@@ -0,0 +1,134 @@
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "engine.hpp"
+#include "flow.hpp"
+#include "histogram.hpp"
+#include "orderbook.hpp"
+#include "runtime.hpp"
+
+// Synthetic market-making flow from flow.hpp through the Orderbook and Engine, reporting
+// throughput and latency percentiles. Every run is seeded, so the commands are the same each time.
+constexpr int MIN_PRICE = 30000;
+constexpr int MAX_PRICE = 60000;
+constexpr uint32_t MAKER = 0;
+constexpr uint32_t TAKER = 1;
+constexpr uint32_t BTC = 0;
+constexpr int WARMUP = 20000; // Commands run before timing so the book reaches its steady size
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+static void report(benchmark::State& state, Histogram& latency) {
+    state.counters["p50_ns"] = latency.percentile(0.5);
+    state.counters["p99_ns"] = latency.percentile(0.99);
+    state.counters["p999_ns"] = latency.percentile(0.999);
+    state.counters["max_ns"] = latency.get_max();
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Turns a command into an order; takers are market orders capped at the depth they can reach,
+// the same way the server enters them
+static Order make_order(const FlowCommand& command, uint64_t opposite_depth) {
+    if (command.action == FLOW_TAKE) {
+        int price = command.direction == BUY ? MAX_PRICE : MIN_PRICE;
+        return Order{command.order_id, std::min(command.quantity, opposite_depth), price, TAKER, BTC, command.direction};
+    }
+    return Order{command.order_id, command.quantity, command.price, MAKER, BTC, command.direction};
+}
+
+static void apply(Orderbook& book, const FlowCommand& command) {
+    if (command.action == FLOW_CANCEL) {
+        benchmark::DoNotOptimize(book.cancel_order(command.order_id));
+        return;
+    }
+    thread_local std::vector<Fill> fills;
+    Order order = make_order(command, command.direction == BUY ? book.get_sell_depth() : book.get_buy_depth());
+    book.place_order(order, fills);
+    fills.clear();
+}
+
+static void apply(Engine& engine, const FlowCommand& command) {
+    if (command.action == FLOW_CANCEL) {
+        benchmark::DoNotOptimize(engine.cancel_order(command.order_id));
+        return;
+    }
+    thread_local std::vector<Fill> fills;
+    Order order = make_order(command, command.direction == BUY ? engine.get_sell_depth(BTC) : engine.get_buy_depth(BTC));
+    engine.place_order(order, fills);
+    fills.clear();
+}
+
+// One book, range(0) as the price distribution and range(1) the cancel share in percent,
+// timing each command on its own
+static void BM_FlowBook(benchmark::State& state) {
+    FlowConfig config;
+    config.prices = static_cast<PriceDistribution>(state.range(0));
+    config.cancel_ratio = state.range(1) / 100.0;
+    Flow flow(config);
+    Orderbook book(MIN_PRICE, MAX_PRICE);
+    for (int i = 0; i < WARMUP; i++) {
+        apply(book, flow.next());
+    }
+
+    Histogram latency;
+    for (auto _ : state) {
+        FlowCommand command = flow.next();
+        uint64_t start = now_ns();
+        apply(book, command);
+        latency.record(now_ns() - start);
+    }
+    report(state, latency);
+    state.counters["live"] = flow.get_live();
+}
+BENCHMARK(BM_FlowBook)
+    ->Args({PRICES_UNIFORM, 45})->Args({PRICES_NORMAL, 45})->Args({PRICES_EXPONENTIAL, 45})
+    ->Args({PRICES_EXPONENTIAL, 90});
+
+// Through an Engine with range(0) shards. With range(1) = 0 commands go back to back (closed
+// loop); otherwise they arrive as a Poisson process at range(1) thousand per second (open loop)
+// and latency counts from when each was due, so falling behind shows up as queueing in the tail.
+// range(2) = 1 runs the low-latency mode: shards busy-poll instead of parking and books sit on
+// huge pages. Its effect is on jitter, so compare p99 and above with and without it.
+static void BM_FlowEngine(benchmark::State& state) {
+    FlowConfig config;
+    config.rate = state.range(1) * 1000.0;
+    Flow flow(config);
+    bool low_latency = state.range(2);
+    if (low_latency && std::thread::hardware_concurrency() <= static_cast<unsigned>(state.range(0))) {
+        state.SkipWithError("busy polling needs a core per shard plus one for the caller");
+        return;
+    }
+    set_huge_pages(low_latency);
+    Engine engine({Market{"BTC", MIN_PRICE, MAX_PRICE}}, state.range(0), Orderbook::DEFAULT_DEPTH, {}, low_latency);
+    for (int i = 0; i < WARMUP; i++) {
+        apply(engine, flow.next());
+    }
+
+    Histogram latency;
+    uint64_t due = now_ns();
+    for (auto _ : state) {
+        FlowCommand command = flow.next();
+        if (config.rate > 0) {
+            due += flow.next_gap_ns();
+            while (now_ns() < due) {
+            }
+        } else {
+            due = now_ns();
+        }
+        apply(engine, command);
+        latency.record(now_ns() - due);
+    }
+    report(state, latency);
+    set_huge_pages(false);
+}
+BENCHMARK(BM_FlowEngine)
+    ->Args({0, 0, 0})->Args({1, 0, 0})->Args({1, 100, 0})->Args({1, 500, 0})
+    ->Args({1, 0, 1})->Args({1, 10, 0})->Args({1, 10, 1})->Args({1, 100, 1})
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,136 @@
+// Loopback comparison of REST and binary order entry against a running server, e.g.
+//   build/orderbook --port 8080 --binary-port 9090
+//   build/orderbook_gateway_bench 8080 9090 100000
+#include <arpa/inet.h>
+#include <chrono>
+#include <cpr/cpr.h>
+#include <cstring>
+#include <iostream>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "histogram.hpp"
+#include "protocol.hpp"
+
+static const std::string USER = "gateway_bench";
+static const std::string ASSET = "gwbench";
+static constexpr int PRICE = 500;
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+static void report(const std::string& name, Histogram& latency, uint64_t elapsed_ns) {
+    std::cout << name << ": " << latency.get_count() * 1e9 / elapsed_ns << " orders/s, round trip"
+              << " p50 " << latency.percentile(0.5) << " ns"
+              << " p99 " << latency.percentile(0.99) << " ns"
+              << " p999 " << latency.percentile(0.999) << " ns"
+              << " max " << latency.get_max() << " ns" << std::endl;
+}
+
+// Reads exactly one message into buffer
+static bool read_message(int fd, char* buffer) {
+    size_t got = 0;
+    size_t want = sizeof(MessageHeader);
+    while (got < want) {
+        ssize_t n = recv(fd, buffer + got, want - got, 0);
+        if (n <= 0) return false;
+        got += n;
+        if (got == sizeof(MessageHeader)) {
+            want = reinterpret_cast<MessageHeader*>(buffer)->length;
+        }
+    }
+    return true;
+}
+
+// Alternating buy/sell limit orders at one price over REST, so each pair crosses
+static void bench_rest(int port, int count) {
+    std::string base = "http://127.0.0.1:" + std::to_string(port);
+    cpr::Session session;
+    Histogram latency;
+    uint64_t start = now_ns();
+    for (int i = 0; i < count; i++) {
+        std::string direction = i % 2 ? "sell" : "buy";
+        session.SetUrl(cpr::Url{base + "/limit/" + USER + "/" + direction + "/" + ASSET + "/1/" + std::to_string(PRICE)});
+        uint64_t sent = now_ns();
+        cpr::Response r = session.Post();
+        latency.record(now_ns() - sent);
+        if (r.status_code != 200) {
+            std::cerr << "REST order failed with status " << r.status_code << std::endl;
+            return;
+        }
+    }
+    report("rest", latency, now_ns() - start);
+}
+
+// Same flow over the binary protocol, timing each order until its accept arrives
+static void bench_binary(int port, int count) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*) &addr, sizeof(addr)) < 0) {
+        std::cerr << "Could not connect to binary port " << port << std::endl;
+        return;
+    }
+
+    char buffer[MAX_MESSAGE_SIZE];
+    LoginMessage login{{sizeof(LoginMessage), MSG_LOGIN}, {}};
+    strncpy(login.user, USER.c_str(), NAME_SIZE);
+    send(fd, &login, sizeof(login), 0);
+    if (!read_message(fd, buffer) || buffer[2] != MSG_LOGGED_IN) {
+        std::cerr << "Binary login failed" << std::endl;
+        return;
+    }
+
+    OrderMessage order{};
+    order.header = MessageHeader{sizeof(OrderMessage), MSG_ORDER};
+    strncpy(order.asset, ASSET.c_str(), NAME_SIZE);
+    order.type = LIMIT;
+    order.quantity = 1;
+    order.price = PRICE;
+
+    Histogram latency;
+    uint64_t start = now_ns();
+    for (int i = 0; i < count; i++) {
+        order.client_ref = i;
+        order.direction = i % 2 ? SELL : BUY;
+        uint64_t sent = now_ns();
+        send(fd, &order, sizeof(order), 0);
+        // Executions for earlier orders may arrive first, skip to our accept
+        do {
+            if (!read_message(fd, buffer)) {
+                std::cerr << "Binary session closed" << std::endl;
+                return;
+            }
+        } while (buffer[2] != MSG_ACCEPTED && buffer[2] != MSG_REJECTED);
+        latency.record(now_ns() - sent);
+    }
+    report("binary", latency, now_ns() - start);
+    close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <rest port> <binary port> [orders]" << std::endl;
+        return 1;
+    }
+    int rest_port = std::stoi(argv[1]);
+    int binary_port = std::stoi(argv[2]);
+    int count = argc > 3 ? std::stoi(argv[3]) : 100000;
+
+    // Fills go to a callback nobody listens on; delivery is off the order path anyway
+    std::string base = "http://127.0.0.1:" + std::to_string(rest_port);
+    cpr::Post(cpr::Url{base + "/user/" + USER + "/http://127.0.0.1:9/"});
+    cpr::Post(cpr::Url{base + "/books/" + ASSET + "/1/1000"});
+
+    bench_rest(rest_port, count);
+    bench_binary(binary_port, count);
+    return 0;
+}
@@ -0,0 +1,523 @@
+#include <benchmark/benchmark.h>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unistd.h>
+#include <vector>
+#include "engine.hpp"
+#include "feed.hpp"
+#include "journal.hpp"
+#include "json.hpp"
+#include "orderbook.hpp"
+
+// Book shape shared by every benchmark below
+constexpr int MIN_PRICE = 30000;
+constexpr int MAX_PRICE = 60000;
+constexpr int MID_PRICE = 45000;
+constexpr uint32_t MAKER = 0;
+constexpr uint32_t TAKER = 1;
+constexpr uint32_t BTC = 0;
+
+// Resident set size in KiB
+static long rss_kb() {
+    long pages = 0, resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+// Rests `resting` orders around the mid then cancels and re-adds one per iteration
+static void BM_AddCancel(benchmark::State& state) {
+    std::vector<Fill> fills;
+    const int resting = state.range(0);
+    Orderbook book(MIN_PRICE, MAX_PRICE, static_cast<Storage>(state.range(1)));
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> offset(1, 200);
+    uint64_t order_id = 0;
+
+    for (int i = 0; i < resting; i++) {
+        bool dir = i % 2 ? SELL : BUY;
+        int price = dir == BUY ? MID_PRICE - offset(rng) : MID_PRICE + offset(rng);
+        Order order{order_id++, 10, price, MAKER, BTC, dir};
+        book.place_order(order, fills);
+    }
+
+    uint64_t oldest = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(book.cancel_order(oldest++));
+        bool dir = order_id % 2 ? SELL : BUY;
+        int price = dir == BUY ? MID_PRICE - offset(rng) : MID_PRICE + offset(rng);
+        Order order{order_id++, 10, price, MAKER, BTC, dir};
+        book.place_order(order, fills);
+        fills.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_AddCancel)->Args({1000, DENSE})->Args({100000, DENSE})->Args({100000, PAGED});
+
+// Reads the top 10 levels of each side after an add/cancel pair, either deep in the book where the
+// cached depth view survives (range(0) = 0) or at the touch where it has to be rebuilt
+static void BM_Depth(benchmark::State& state) {
+    std::vector<Fill> fills;
+    Orderbook book(MIN_PRICE, MAX_PRICE);
+    uint64_t order_id = 0;
+    for (int i = 1; i <= 1000; i++) {
+        Order bid{order_id++, 10, MID_PRICE - i, MAKER, BTC, BUY};
+        book.place_order(bid, fills);
+        Order ask{order_id++, 10, MID_PRICE + i, MAKER, BTC, SELL};
+        book.place_order(ask, fills);
+    }
+    const int price = state.range(0) ? MID_PRICE - 1 : MID_PRICE - 500;
+    std::vector<std::pair<int, uint64_t>> bids, asks;
+    for (auto _ : state) {
+        Order order{order_id, 1, price, MAKER, BTC, BUY};
+        book.place_order(order, fills);
+        book.cancel_order(order_id++);
+        book.publish();
+        benchmark::DoNotOptimize(book.get_depth(10, bids, asks));
+    }
+}
+BENCHMARK(BM_Depth)->Arg(0)->Arg(1);
+
+// Rests a maker at the touch then takes it with an opposing order of the same size
+static void BM_AddFill(benchmark::State& state) {
+    std::vector<Fill> fills;
+    Orderbook book(MIN_PRICE, MAX_PRICE);
+    uint64_t order_id = 0;
+
+    for (auto _ : state) {
+        Order maker{order_id++, 10, MID_PRICE, MAKER, BTC, SELL};
+        book.place_order(maker, fills);
+        Order taker{order_id++, 10, MID_PRICE, TAKER, BTC, BUY};
+        book.place_order(taker, fills);
+        fills.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_AddFill);
+
+// Makers and takers of random sides, so the direction each command matches in can't be predicted
+static void BM_MixedFill(benchmark::State& state) {
+    std::vector<Fill> fills;
+    Orderbook book(MIN_PRICE, MAX_PRICE);
+    std::mt19937 rng(42);
+    uint64_t order_id = 0;
+
+    for (auto _ : state) {
+        bool dir = rng() % 2 ? SELL : BUY;
+        int offset = 1 + rng() % 4;
+        Order maker{order_id++, 10, dir == BUY ? MID_PRICE - offset : MID_PRICE + offset, MAKER, BTC, dir};
+        book.place_order(maker, fills);
+        Order taker{order_id++, 10, dir == BUY ? MIN_PRICE : MAX_PRICE, TAKER, BTC, !dir};
+        book.place_order(taker, fills);
+        fills.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_MixedFill);
+
+// Aggressive order sweeping `levels` price levels that are refilled every iteration
+static void BM_Sweep(benchmark::State& state) {
+    std::vector<Fill> fills;
+    const int levels = state.range(0);
+    Orderbook book(MIN_PRICE, MAX_PRICE);
+    uint64_t order_id = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (int i = 0; i < levels; i++) {
+            Order maker{order_id++, 10, MID_PRICE + i, MAKER, BTC, SELL};
+            book.place_order(maker, fills);
+        }
+        state.ResumeTiming();
+        Order taker{order_id++, (uint64_t) (10 * levels), MID_PRICE + levels, TAKER, BTC, BUY};
+        book.place_order(taker, fills);
+        fills.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * levels);
+}
+BENCHMARK(BM_Sweep)->Arg(50);
+
+// Thin book spanning the whole band: cancelling the top bid must find the next one far below
+static void BM_CancelThinTop(benchmark::State& state) {
+    std::vector<Fill> fills;
+    Orderbook book(MIN_PRICE, MAX_PRICE);
+    uint64_t order_id = 0;
+    Order floor{order_id++, 10, MIN_PRICE, MAKER, BTC, BUY};
+    book.place_order(floor, fills);
+
+    for (auto _ : state) {
+        Order top{order_id, 10, MAX_PRICE - 1, MAKER, BTC, BUY};
+        book.place_order(top, fills);
+        benchmark::DoNotOptimize(book.cancel_order(order_id++));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_CancelThinTop);
+
+// Startup cost and memory of a book over a very wide band with a few orders near the mid
+static void BM_ConstructWide(benchmark::State& state) {
+    std::vector<Fill> fills;
+    const Storage storage = static_cast<Storage>(state.range(0));
+    const int width = state.range(1);
+    long rss = 0;
+
+    for (auto _ : state) {
+        long before = rss_kb();
+        Orderbook book(0, width, storage);
+        for (uint64_t i = 0; i < 100; i++) {
+            Order order{i, 10, width / 2 + (int) i, MAKER, BTC, BUY};
+            book.place_order(order, fills);
+        }
+        rss = rss_kb() - before;
+        benchmark::DoNotOptimize(book.get_buy_depth());
+    }
+    state.counters["rss_kb"] = rss;
+}
+BENCHMARK(BM_ConstructWide)->Args({DENSE, 10000000})->Args({PAGED, 10000000})->Unit(benchmark::kMillisecond);
+
+// Add/fill pairs through the Engine, one asset per benchmark thread, with range(0) matching shards
+static void BM_EngineAddFill(benchmark::State& state) {
+    std::vector<Fill> fills;
+    static std::unique_ptr<Engine> engine;
+    if (state.thread_index() == 0) {
+        std::vector<Market> markets;
+        for (int i = 0; i < state.threads(); i++) {
+            markets.push_back(Market{"asset" + std::to_string(i), MIN_PRICE, MAX_PRICE});
+        }
+        engine = std::make_unique<Engine>(markets, state.range(0));
+    }
+    const uint32_t asset = state.thread_index();
+    uint64_t order_id = (uint64_t) asset << 40;
+
+    for (auto _ : state) {
+        Order maker{order_id++, 10, MID_PRICE, MAKER, asset, SELL};
+        engine->place_order(maker, fills);
+        Order taker{order_id++, 10, MID_PRICE, TAKER, asset, BUY};
+        engine->place_order(taker, fills);
+        fills.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+    if (state.thread_index() == 0) {
+        engine.reset();
+    }
+}
+BENCHMARK(BM_EngineAddFill)->Arg(0)->Arg(4)->Threads(1)->Threads(4)->UseRealTime();
+
+// A maker re-quoting one of 1000 resting orders per iteration through an Engine matching on
+// range(1) shards: range(0) = 0 cancels it and places a new order, 1 modifies it to a new price
+// and 2 shrinks it in place. Items are re-quotes, so the first pays for two engine trips per item.
+static void BM_EngineRequote(benchmark::State& state) {
+    constexpr size_t RESTING = 1000;
+    std::vector<Fill> fills;
+    RejectReason reason;
+    Engine engine({Market{"BTC", MIN_PRICE, MAX_PRICE}}, state.range(1));
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> offset(1, 200);
+    std::vector<Order> quotes;
+    uint64_t order_id = 0;
+    for (size_t i = 0; i < RESTING; i++) {
+        Order order{order_id++, 1ULL << 40, MID_PRICE - offset(rng), MAKER, BTC, BUY};
+        engine.place_order(order, fills);
+        quotes.push_back(order);
+    }
+
+    size_t next = 0;
+    for (auto _ : state) {
+        Order& quote = quotes[next];
+        next = (next + 1) % RESTING;
+        if (state.range(0) == 0) {
+            engine.cancel_order(quote.order_id);
+            quote.order_id = order_id++;
+            quote.price = MID_PRICE - offset(rng);
+            Order order = quote;
+            engine.place_order(order, fills);
+        } else if (state.range(0) == 1) {
+            quote.price = MID_PRICE - offset(rng);
+            engine.modify_order(quote.order_id, quote.quantity, quote.price, fills, reason);
+        } else {
+            engine.modify_order(quote.order_id, --quote.quantity, quote.price, fills, reason);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EngineRequote)->Args({0, 0})->Args({1, 0})->Args({2, 0})->Args({0, 1})->Args({1, 1})->UseRealTime();
+
+// Kill switch: pulls one maker's 100k resting orders, spread over 8 books and interleaved with
+// another maker's 100k, through an Engine matching on range(1) shards. range(0) = 0 cancels them
+// one id at a time as a client tracking its ids would, 1 with a single cancel_user.
+static void BM_KillSwitch(benchmark::State& state) {
+    constexpr uint64_t ORDERS = 100000;
+    constexpr uint32_t BOOKS = 8;
+    std::vector<Fill> fills;
+    std::vector<Order> cancelled;
+    std::vector<Market> markets;
+    for (uint32_t i = 0; i < BOOKS; i++) {
+        markets.push_back(Market{"asset" + std::to_string(i), MIN_PRICE, MAX_PRICE});
+    }
+    Engine engine(markets, state.range(1));
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> offset(1, 200);
+    uint64_t order_id = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (uint64_t i = 0; i < 2 * ORDERS; i++) {
+            bool dir = i % 4 < 2 ? BUY : SELL;
+            int price = dir == BUY ? MID_PRICE - offset(rng) : MID_PRICE + offset(rng);
+            Order order{order_id++, 10, price, i % 2 ? TAKER : MAKER, static_cast<uint32_t>(i / 2 % BOOKS), dir};
+            engine.place_order(order, fills);
+        }
+        state.ResumeTiming();
+        cancelled.clear();
+        if (state.range(0) == 0) {
+            for (uint64_t id = order_id - 2 * ORDERS; id < order_id; id += 2) {
+                benchmark::DoNotOptimize(engine.cancel_order(id));
+            }
+        } else {
+            engine.cancel_user(MAKER, std::nullopt, cancelled);
+        }
+        state.PauseTiming();
+        engine.cancel_user(TAKER, std::nullopt, cancelled);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * ORDERS);
+}
+BENCHMARK(BM_KillSwitch)->Args({0, 0})->Args({1, 0})->Args({0, 2})->Args({1, 2})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Thread 0 places add/fill pairs through an inline Engine while every other thread reads the
+// book's published top, so reads per second show what readers get and thread 0 what they cost it
+static void BM_ReadTop(benchmark::State& state) {
+    std::vector<Fill> fills;
+    static std::unique_ptr<Engine> engine;
+    if (state.thread_index() == 0) {
+        engine = std::make_unique<Engine>(std::vector<Market>{Market{"BTC", MIN_PRICE, MAX_PRICE}}, 0);
+        for (int i = 1; i <= 100; i++) {
+            Order bid{(uint64_t) i, 10, MID_PRICE - i, MAKER, BTC, BUY};
+            engine->place_order(bid, fills);
+        }
+    }
+    uint64_t order_id = 1000;
+
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            Order maker{order_id++, 10, MID_PRICE, MAKER, BTC, SELL};
+            engine->place_order(maker, fills);
+            Order taker{order_id++, 10, MID_PRICE, TAKER, BTC, BUY};
+            engine->place_order(taker, fills);
+            fills.clear();
+        } else {
+            benchmark::DoNotOptimize(engine->get_top(BTC));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        engine.reset();
+    }
+}
+BENCHMARK(BM_ReadTop)->Threads(1)->Threads(2)->Threads(4)->UseRealTime();
+
+// Add/cancel through an inline Engine, publishing level deltas to a subscribed feed when range(0)
+// is set, to show what tracking costs the matching path
+static void BM_FeedAddCancel(benchmark::State& state) {
+    std::vector<Fill> fills;
+    Engine engine({Market{"BTC", MIN_PRICE, MAX_PRICE}}, 0);
+    std::atomic<uint64_t> delivered = 0;
+    std::unique_ptr<Feed> feed;
+    if (state.range(0)) {
+        feed = std::make_unique<Feed>(
+            [&delivered](const FeedBatch& batch) { delivered += batch.updates.size(); },
+            [](const std::vector<uint32_t>&) {},
+            0
+        );
+        engine.set_feed(feed.get());
+        feed->subscribe(BTC);
+    }
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> offset(1, 200);
+    uint64_t order_id = 0;
+    for (int i = 0; i < 1000; i++) {
+        bool dir = i % 2 ? SELL : BUY;
+        int price = dir == BUY ? MID_PRICE - offset(rng) : MID_PRICE + offset(rng);
+        Order order{order_id++, 10, price, MAKER, BTC, dir};
+        engine.place_order(order, fills);
+    }
+
+    uint64_t oldest = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(engine.cancel_order(oldest++));
+        bool dir = order_id % 2 ? SELL : BUY;
+        int price = dir == BUY ? MID_PRICE - offset(rng) : MID_PRICE + offset(rng);
+        Order order{order_id++, 10, price, MAKER, BTC, dir};
+        engine.place_order(order, fills);
+        fills.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+    engine.set_feed(nullptr);
+    feed.reset();
+    state.counters["delivered"] = delivered.load();
+}
+BENCHMARK(BM_FeedAddCancel)->Arg(0)->Arg(1);
+
+// Scratch directory for journal benchmarks, emptied first
+static std::string journal_dir(const std::string& name) {
+    std::string dir = (std::filesystem::temp_directory_path() / ("orderbook_bench_" + name)).string();
+    std::filesystem::remove_all(dir);
+    return dir;
+}
+
+// Appends and commits one order record per iteration, with range(0) as the durability mode.
+// With several threads under DURABLE_SYNC, concurrent commits share fsyncs.
+static void BM_JournalAppend(benchmark::State& state) {
+    static std::unique_ptr<Journal> journal;
+    if (state.thread_index() == 0) {
+        journal = std::make_unique<Journal>(journal_dir("append"), static_cast<Durability>(state.range(0)));
+    }
+    uint64_t order_id = (uint64_t) state.thread_index() << 40;
+
+    for (auto _ : state) {
+        Order order{order_id++, 10, MID_PRICE, MAKER, BTC, BUY};
+        journal->commit(journal->append(RECORD_ORDER, &order, sizeof(order)));
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        journal.reset();
+    }
+}
+BENCHMARK(BM_JournalAppend)->Arg(DURABLE_NONE)->Arg(DURABLE_BATCH)->Threads(1)->UseRealTime();
+BENCHMARK(BM_JournalAppend)->Arg(DURABLE_SYNC)->Threads(1)->Threads(8)->UseRealTime();
+
+// Rebuilds a book from range(0) journaled commands shaped like market making: half are quotes
+// resting near the mid, 40% cancel the oldest live quote and 10% are takers crossing the spread
+static void BM_JournalReplay(benchmark::State& state) {
+    const int64_t records = state.range(0);
+    std::string dir = journal_dir("replay");
+    {
+        Journal journal(dir, DURABLE_NONE);
+        Market market{"BTC", MIN_PRICE, MAX_PRICE};
+        BookRecord book{market.min, market.max, DENSE, market.tick};
+        std::string payload(reinterpret_cast<const char*>(&book), sizeof(book));
+        payload += market.name;
+        journal.append(RECORD_BOOK, payload.data(), payload.size());
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> offset(1, 200);
+        std::deque<uint64_t> live;
+        uint64_t order_id = 0;
+        for (int64_t i = 0; i < records; i++) {
+            int kind = i % 10;
+            if (kind >= 5 && kind < 9 && !live.empty()) {
+                journal.append(RECORD_CANCEL, &live.front(), sizeof(uint64_t));
+                live.pop_front();
+                continue;
+            }
+            bool dir = rng() % 2 ? SELL : BUY;
+            int price = dir == BUY ? MID_PRICE - offset(rng) : MID_PRICE + offset(rng);
+            if (kind == 9) {
+                price = dir == BUY ? MAX_PRICE : MIN_PRICE;
+            } else {
+                live.push_back(order_id);
+            }
+            Order order{order_id++, 10, price, kind == 9 ? TAKER : MAKER, BTC, dir};
+            journal.append(RECORD_ORDER, &order, sizeof(order));
+        }
+    }
+
+    for (auto _ : state) {
+        Journal journal(dir, DURABLE_NONE);
+        Engine engine;
+        journal.replay(0, [&engine](const RecordHeader& header, const char* payload) {
+            engine.restore(header, payload);
+        });
+        benchmark::DoNotOptimize(engine.get_buy_depth(0));
+    }
+    state.SetItemsProcessed(state.iterations() * records);
+    std::filesystem::remove_all(dir);
+}
+BENCHMARK(BM_JournalReplay)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_JournalReplay)->Arg(10000000)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+// Copies a book holding range(0) resting orders out for a snapshot; this is how long its
+// shard stops matching
+static void BM_SnapshotCapture(benchmark::State& state) {
+    std::vector<Fill> fills;
+    const int resting = state.range(0);
+    Engine engine({Market{"BTC", MIN_PRICE, MAX_PRICE}}, 0);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> offset(1, 200);
+    for (int i = 0; i < resting; i++) {
+        bool dir = i % 2 ? SELL : BUY;
+        int price = dir == BUY ? MID_PRICE - offset(rng) : MID_PRICE + offset(rng);
+        Order order{(uint64_t) i, 10, price, MAKER, BTC, dir};
+        engine.place_order(order, fills);
+    }
+
+    for (auto _ : state) {
+        std::vector<std::string> assets;
+        std::vector<BookImage> books;
+        engine.capture(assets, books);
+        benchmark::DoNotOptimize(books.data());
+    }
+    state.SetItemsProcessed(state.iterations() * resting);
+}
+BENCHMARK(BM_SnapshotCapture)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+// Streams range(0) orders through an inline Engine, each cancelled again 10000 orders later like
+// quotes being re-priced. Ids keep climbing, so rss_kb and table_kb at the end show whether
+// memory stays flat over a long run or grows with every id ever used.
+static void BM_CancelChurn(benchmark::State& state) {
+    const uint64_t orders = state.range(0);
+    constexpr uint64_t LIVE = 10000;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> offset(1, 200);
+    std::vector<Fill> fills;
+
+    for (auto _ : state) {
+        Engine engine({Market{"BTC", MIN_PRICE, MAX_PRICE}}, 0);
+        long before = rss_kb();
+        for (uint64_t order_id = 0; order_id < orders; order_id++) {
+            bool dir = order_id % 2 ? SELL : BUY;
+            int price = dir == BUY ? MID_PRICE - offset(rng) : MID_PRICE + offset(rng);
+            Order order{order_id, 10, price, MAKER, BTC, dir};
+            engine.place_order(order, fills);
+            if (order_id >= LIVE) {
+                benchmark::DoNotOptimize(engine.cancel_order(order_id - LIVE));
+            }
+        }
+        state.counters["rss_kb"] = rss_kb() - before;
+        state.counters["table_kb"] = engine.get_location_bytes() / 1024;
+    }
+    state.SetItemsProcessed(state.iterations() * orders * 2);
+}
+BENCHMARK(BM_CancelChurn)->Arg(1000000)->Arg(100000000)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+// Writes one fill callback body per iteration into a reused buffer, as the server does for each
+// side of every fill
+static void BM_JsonFillCallback(benchmark::State& state) {
+    const JsonShape shape{"user", "direction", "asset", "quantity", "price", "status"};
+    const std::string user = "market-maker-7";
+    const std::string asset = "BTC";
+    std::string body;
+    uint64_t quantity = 1;
+    for (auto _ : state) {
+        body.clear();
+        JsonWriter json(body);
+        json.begin_object();
+        for (size_t field : shape) {
+            json.key(shape, field);
+            switch (field) {
+                case 0: json.value(user); break;
+                case 1: json.value("buy"); break;
+                case 2: json.value(asset); break;
+                case 3: json.value(quantity++); break;
+                case 4: json.value(MID_PRICE); break;
+                case 5: json.value("filled"); break;
+            }
+        }
+        json.end_object();
+        benchmark::DoNotOptimize(body.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JsonFillCallback);
+
+BENCHMARK_MAIN();
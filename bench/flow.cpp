@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <cmath>
+#include "flow.hpp"
+
+Flow::Flow(const FlowConfig& config) : config(config), rng(config.seed), next_id(1) {
+    this->live.reserve(config.max_live);
+}
+
+FlowCommand Flow::next() {
+    double roll = std::uniform_real_distribution<double>(0, 1)(this->rng);
+    bool cancel = !this->live.empty() && (roll < this->config.cancel_ratio || this->live.size() >= this->config.max_live);
+    if (cancel) {
+        // Any live quote, not just the oldest, like a maker re-pricing its ladder
+        size_t idx = std::uniform_int_distribution<size_t>(0, this->live.size() - 1)(this->rng);
+        uint64_t order_id = this->live[idx];
+        this->live[idx] = this->live.back();
+        this->live.pop_back();
+        return FlowCommand{FLOW_CANCEL, BUY, 0, 0, order_id};
+    }
+
+    bool direction = std::uniform_int_distribution<int>(0, 1)(this->rng) ? SELL : BUY;
+    if (roll < this->config.cancel_ratio + this->config.take_ratio) {
+        uint64_t quantity = std::uniform_int_distribution<uint64_t>(1, this->config.take_quantity)(this->rng);
+        return FlowCommand{FLOW_TAKE, direction, 0, quantity, this->next_id++};
+    }
+    int offset = this->quote_offset();
+    uint64_t quantity = std::uniform_int_distribution<uint64_t>(1, this->config.quote_quantity)(this->rng);
+    int price = direction == BUY ? this->config.mid - offset : this->config.mid + offset;
+    this->live.push_back(this->next_id);
+    return FlowCommand{FLOW_QUOTE, direction, price, quantity, this->next_id++};
+}
+
+// Time until the next arrival of a Poisson process at the configured rate
+uint64_t Flow::next_gap_ns() {
+    if (this->config.rate <= 0) {
+        return 0;
+    }
+    return std::exponential_distribution<double>(this->config.rate)(this->rng) * 1e9;
+}
+
+size_t Flow::get_live() {
+    return this->live.size();
+}
+
+int Flow::quote_offset() {
+    double ticks;
+    if (this->config.prices == PRICES_UNIFORM) {
+        ticks = std::uniform_real_distribution<double>(0, 2 * this->config.spread)(this->rng);
+    } else if (this->config.prices == PRICES_NORMAL) {
+        ticks = std::abs(std::normal_distribution<double>(0, this->config.spread)(this->rng));
+    } else {
+        ticks = std::exponential_distribution<double>(1 / this->config.spread)(this->rng);
+    }
+    return std::min(1 + static_cast<int>(ticks), this->config.width);
+}
+
+bool parse_prices(const std::string& name, PriceDistribution& prices) {
+    if (name == "uniform") {
+        prices = PRICES_UNIFORM;
+    } else if (name == "normal") {
+        prices = PRICES_NORMAL;
+    } else if (name == "exponential") {
+        prices = PRICES_EXPONENTIAL;
+    } else {
+        return false;
+    }
+    return true;
+}
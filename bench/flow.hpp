@@ -0,0 +1,66 @@
+#ifndef FLOW_H
+#define FLOW_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "order.hpp"
+
+enum FlowAction {
+    FLOW_QUOTE, // Limit order resting near the mid
+    FLOW_CANCEL, // Pulls one of the flow's live quotes
+    FLOW_TAKE, // Market order sweeping the other side
+};
+
+// How far from the mid quotes land
+enum PriceDistribution {
+    PRICES_UNIFORM, // 1 to 2 * spread ticks
+    PRICES_NORMAL, // |N(0, spread)| + 1 ticks
+    PRICES_EXPONENTIAL, // Exp(mean spread) + 1 ticks, so most quotes crowd the touch
+};
+
+struct FlowConfig {
+    uint64_t seed = 1;
+    int mid = 45000;
+    int width = 1000; // Furthest a quote lands from the mid in ticks
+    PriceDistribution prices = PRICES_EXPONENTIAL;
+    double spread = 10; // Scale of the distribution in ticks
+    double cancel_ratio = 0.45; // Share of commands that cancel
+    double take_ratio = 0.05; // Share of commands that take; the rest quote
+    uint64_t quote_quantity = 100; // Quotes are for 1 to this
+    uint64_t take_quantity = 1000; // Takers are for 1 to this, enough to sweep a few levels
+    size_t max_live = 10000; // Quotes kept live before every command cancels one
+    double rate = 0; // Mean commands per second, for Poisson arrival gaps
+};
+
+// One command; `order_id` is the flow's id for the new order, or the quote to cancel
+struct FlowCommand {
+    FlowAction action;
+    bool direction;
+    int price;
+    uint64_t quantity;
+    uint64_t order_id;
+};
+
+// Deterministic synthetic order flow shaped like market making: quotes rest around a fixed mid,
+// most get cancelled again, and now and then a taker sweeps the touch. Everything comes from one
+// seeded generator, so the same config gives the same commands on every run.
+class Flow {
+public:
+    Flow(const FlowConfig& config);
+    FlowCommand next();
+    uint64_t next_gap_ns();
+    size_t get_live();
+
+private:
+    FlowConfig config;
+    std::mt19937_64 rng;
+    uint64_t next_id;
+    std::vector<uint64_t> live; // Quotes not yet cancelled; some may have been filled since
+    int quote_offset();
+};
+
+bool parse_prices(const std::string& name, PriceDistribution& prices);
+
+#endif // FLOW_H
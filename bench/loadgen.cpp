@@ -0,0 +1,284 @@
+// HTTP load generator running the synthetic flow from flow.hpp against a running server, e.g.
+//   build/orderbook --port 8080
+//   build/orderbook_loadgen --port 8080 --connections 4 --rate 20000 --orders 200000 --seed 7
+// Without --rate it runs closed loop: each connection sends its next command as soon as the last
+// reply is in. With --rate commands arrive as a Poisson process at that total rate, and latency
+// counts from when each was due, so a server falling behind shows up in the tail rather than
+// quietly slowing the generator down.
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <string>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "flow.hpp"
+#include "histogram.hpp"
+
+static const std::string USER = "loadgen";
+static constexpr int MIN_PRICE = 30000;
+static constexpr int MAX_PRICE = 60000;
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+// Keep-alive HTTP/1.1 connection sending one request at a time
+class Connection {
+public:
+    Connection(const std::string& host, int port);
+    ~Connection();
+    bool post(const std::string& path, int& status, std::string& body);
+
+private:
+    int fd;
+    std::string buffer; // Bytes read past the end of the last reply
+    bool read_more();
+};
+
+Connection::Connection(const std::string& host, int port) {
+    this->fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(this->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+        throw std::runtime_error("not an IPv4 address: " + host);
+    }
+    if (connect(this->fd, (sockaddr*) &addr, sizeof(addr)) < 0) {
+        throw std::runtime_error("could not connect to " + host + ":" + std::to_string(port));
+    }
+}
+
+Connection::~Connection() {
+    close(this->fd);
+}
+
+bool Connection::read_more() {
+    char chunk[4096];
+    ssize_t n = recv(this->fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+        return false;
+    }
+    this->buffer.append(chunk, n);
+    return true;
+}
+
+// Sends an empty POST and reads the reply; false if the connection broke
+bool Connection::post(const std::string& path, int& status, std::string& body) {
+    std::string request = "POST " + path + " HTTP/1.1\r\nHost: loadgen\r\nContent-Length: 0\r\n\r\n";
+    if (send(this->fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+        return false;
+    }
+
+    size_t end;
+    while ((end = this->buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (!this->read_more()) return false;
+    }
+    // Skips anything before the status line, such as a body sent after a 204
+    size_t begin = this->buffer.rfind("HTTP/1.", end);
+    if (begin == std::string::npos) {
+        return false;
+    }
+    std::string headers = this->buffer.substr(begin, end - begin);
+    this->buffer.erase(0, end + 4);
+    status = std::stoi(headers.substr(headers.find(' ') + 1, 3));
+
+    size_t length = 0;
+    for (size_t pos = 0; pos < headers.size(); ) {
+        size_t eol = headers.find("\r\n", pos);
+        std::string line = headers.substr(pos, eol == std::string::npos ? std::string::npos : eol - pos);
+        if (strncasecmp(line.c_str(), "content-length:", 15) == 0) {
+            length = std::stoul(line.substr(15));
+        }
+        pos = eol == std::string::npos ? headers.size() : eol + 2;
+    }
+    if (status == 204 || status == 304) {
+        length = 0; // Never has a body, whatever the headers say
+    }
+    while (this->buffer.size() < length) {
+        if (!this->read_more()) return false;
+    }
+    body = this->buffer.substr(0, length);
+    this->buffer.erase(0, length);
+    return true;
+}
+
+// What one connection saw
+struct Result {
+    Histogram latency;
+    uint64_t errors = 0;
+};
+
+// One connection's share of the flow, seeded from the run's seed and its index
+static void run_connection(const std::string& host, int port, const std::string& asset, FlowConfig config, uint64_t count, Result& result) {
+    Flow flow(config);
+    Connection conn(host, port);
+    std::unordered_map<uint64_t, uint64_t> order_ids; // Flow's quote ids to the server's
+    std::string path, body;
+    int status;
+    uint64_t due = now_ns();
+    for (uint64_t i = 0; i < count; i++) {
+        FlowCommand command = flow.next();
+        std::string direction = command.direction == BUY ? "buy" : "sell";
+        if (command.action == FLOW_CANCEL) {
+            auto it = order_ids.find(command.order_id);
+            if (it == order_ids.end()) {
+                continue; // Its quote was rejected
+            }
+            path = "/cancel/" + std::to_string(it->second);
+            order_ids.erase(it);
+        } else if (command.action == FLOW_TAKE) {
+            path = "/market/" + USER + "/" + direction + "/" + asset + "/" + std::to_string(command.quantity);
+        } else {
+            path = "/limit/" + USER + "/" + direction + "/" + asset + "/" + std::to_string(command.quantity) + "/" + std::to_string(command.price);
+        }
+
+        if (config.rate > 0) {
+            due += flow.next_gap_ns();
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(due)));
+        } else {
+            due = now_ns();
+        }
+        if (!conn.post(path, status, body)) {
+            throw std::runtime_error("connection closed by server");
+        }
+        result.latency.record(now_ns() - due);
+
+        if (status != 200 && status != 204) {
+            result.errors++;
+        } else if (command.action == FLOW_QUOTE) {
+            size_t pos = body.find("\"order_id\":");
+            if (pos != std::string::npos) {
+                order_ids[command.order_id] = std::stoull(body.substr(pos + 11));
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int connections = 1;
+    uint64_t orders = 100000;
+    std::string asset = "loadgen";
+    FlowConfig config;
+    std::string usage = "Usage: " + std::string(argv[0]) + " [--host <ipv4>] [--port <port>] [--connections <n>] [--orders <n>] [--rate <per second>] [--seed <n>] [--asset <ticker>] [--prices uniform|normal|exponential] [--spread <ticks>] [--cancel <ratio>] [--take <ratio>]";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Error: No value specified after " << flag << std::endl;
+            std::cerr << usage << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        try {
+            if (flag == "--host") {
+                host = value;
+            } else if (flag == "--port") {
+                port = std::stoi(value);
+            } else if (flag == "--connections") {
+                connections = std::stoi(value);
+            } else if (flag == "--orders") {
+                orders = std::stoull(value);
+            } else if (flag == "--rate") {
+                config.rate = std::stod(value);
+            } else if (flag == "--seed") {
+                config.seed = std::stoull(value);
+            } else if (flag == "--asset") {
+                asset = value;
+            } else if (flag == "--prices") {
+                if (!parse_prices(value, config.prices)) {
+                    std::cerr << "Error: --prices must be one of uniform, normal or exponential" << std::endl;
+                    return 1;
+                }
+            } else if (flag == "--spread") {
+                config.spread = std::stod(value);
+            } else if (flag == "--cancel") {
+                config.cancel_ratio = std::stod(value);
+            } else if (flag == "--take") {
+                config.take_ratio = std::stod(value);
+            } else {
+                std::cerr << "Error: Unknown flag " << flag << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Not a valid number: " << value << std::endl;
+            return 1;
+        }
+    }
+    if (connections < 1) {
+        std::cerr << "Error: --connections must be at least 1" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Result>> results;
+    uint64_t start;
+    try {
+        // Fills go to a callback nobody listens on; delivery is off the order path anyway
+        Connection setup(host, port);
+        int status;
+        std::string body;
+        setup.post("/user/" + USER + "/http://127.0.0.1:9/", status, body);
+        setup.post("/books/" + asset + "/" + std::to_string(MIN_PRICE) + "/" + std::to_string(MAX_PRICE), status, body);
+
+        config.rate /= connections;
+        std::vector<std::thread> threads;
+        std::vector<std::string> failures(connections);
+        for (int i = 0; i < connections; i++) {
+            results.push_back(std::make_unique<Result>());
+        }
+        start = now_ns();
+        for (int i = 0; i < connections; i++) {
+            FlowConfig own = config;
+            own.seed = config.seed + i;
+            uint64_t count = orders / connections + (static_cast<uint64_t>(i) < orders % connections);
+            threads.emplace_back([&, own, count, i] {
+                try {
+                    run_connection(host, port, asset, own, count, *results[i]);
+                } catch (const std::exception& e) {
+                    failures[i] = e.what();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const std::string& failure : failures) {
+            if (!failure.empty()) {
+                throw std::runtime_error(failure);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    Histogram latency;
+    uint64_t errors = 0;
+    for (auto& result : results) {
+        latency.merge(result->latency);
+        errors += result->errors;
+    }
+    std::cout << latency.get_count() << " commands over " << connections << " connections in " << elapsed / 1e9 << " s: "
+              << latency.get_count() * 1e9 / elapsed << " commands/s, " << errors << " errors" << std::endl;
+    std::cout << "latency p50 " << latency.percentile(0.5) << " ns"
+              << " p90 " << latency.percentile(0.9) << " ns"
+              << " p99 " << latency.percentile(0.99) << " ns"
+              << " p999 " << latency.percentile(0.999) << " ns"
+              << " max " << latency.get_max() << " ns" << std::endl;
+    return 0;
+}
@@ -0,0 +1,573 @@
+// Replays recorded order flow straight through the Engine at full speed, without the server, e.g.
+//   build/orderbook_replay import flow.csv flow.bin [--market <ticker> <min> <max> [dense|paged] [tick <size>]]...
+//   build/orderbook_replay run flow.bin [--out events.bin] [--threads <n>]
+// The CSV has one command per line: action,order_id,user,asset,direction,quantity,price where
+// action is limit, market, cancel or modify. Cancels only need the order id, and modifies the
+// order id, quantity and price. Markets not given with --market span the prices seen for them.
+// Assets never interact, so with --threads each thread replays its own share of them through its
+// own Engine. File formats are in replay.hpp.
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "engine.hpp"
+#include "intern.hpp"
+#include "replay.hpp"
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+static void fail(const std::string& what) {
+    throw std::runtime_error("replay: " + what + ": " + std::strerror(errno));
+}
+
+// Buffers output and writes it out in large chunks. Several writers can share a file through
+// `lock`; each chunk holds whole events, so one writer's events stay in order.
+class Writer {
+public:
+    Writer(int fd, std::mutex* lock = nullptr) : fd(fd), lock(lock) {}
+
+    void put(const void* data, size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+        this->buffer.insert(this->buffer.end(), bytes, bytes + length);
+        if (this->buffer.size() >= (1 << 20)) {
+            this->flush();
+        }
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> guard;
+        if (this->lock) {
+            guard = std::unique_lock<std::mutex>(*this->lock);
+        }
+        size_t done = 0;
+        while (done < this->buffer.size()) {
+            ssize_t n = ::write(this->fd, this->buffer.data() + done, this->buffer.size() - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                fail("write");
+            }
+            done += n;
+        }
+        this->buffer.clear();
+    }
+
+private:
+    int fd;
+    std::mutex* lock;
+    std::vector<char> buffer;
+};
+
+// A replay file mapped read-only, checked against its header
+class ReplayFile {
+public:
+    ReplayFile(const std::string& path);
+    ~ReplayFile();
+    const ReplayHeader& get_header() const;
+    const ReplayMarket* get_markets() const;
+    const ReplayCommand* get_commands() const;
+
+private:
+    void* mapping;
+    size_t size;
+};
+
+ReplayFile::ReplayFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fail("open " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) < 0) {
+        ::close(fd);
+        fail("stat " + path);
+    }
+    this->size = info.st_size;
+    if (this->size < sizeof(ReplayHeader)) {
+        ::close(fd);
+        throw std::runtime_error("replay: " + path + " is not a replay file");
+    }
+    this->mapping = ::mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (this->mapping == MAP_FAILED) {
+        fail("mmap " + path);
+    }
+    ::madvise(this->mapping, this->size, MADV_SEQUENTIAL);
+
+    const ReplayHeader& header = this->get_header();
+    if (std::memcmp(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0 || header.version != REPLAY_VERSION) {
+        ::munmap(this->mapping, this->size);
+        throw std::runtime_error("replay: " + path + " is not a replay file");
+    }
+    if (this->size != sizeof(ReplayHeader) + header.markets * sizeof(ReplayMarket) + header.commands * sizeof(ReplayCommand)) {
+        ::munmap(this->mapping, this->size);
+        throw std::runtime_error("replay: " + path + " is truncated");
+    }
+}
+
+ReplayFile::~ReplayFile() {
+    ::munmap(this->mapping, this->size);
+}
+
+const ReplayHeader& ReplayFile::get_header() const {
+    return *static_cast<const ReplayHeader*>(this->mapping);
+}
+
+const ReplayMarket* ReplayFile::get_markets() const {
+    return reinterpret_cast<const ReplayMarket*>(static_cast<const char*>(this->mapping) + sizeof(ReplayHeader));
+}
+
+const ReplayCommand* ReplayFile::get_commands() const {
+    return reinterpret_cast<const ReplayCommand*>(this->get_markets() + this->get_header().markets);
+}
+
+// Splits a CSV line on commas; no quoting, as none of the fields need it
+static std::vector<std::string> split(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find(',', start);
+        fields.push_back(line.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if (end == std::string::npos) {
+            return fields;
+        }
+        start = end + 1;
+    }
+}
+
+static int64_t parse_number(const std::string& text) {
+    size_t used = 0;
+    int64_t value = std::stoll(text, &used);
+    if (used != text.size()) {
+        throw std::invalid_argument(text);
+    }
+    return value;
+}
+
+static uint64_t parse_quantity(const std::string& text) {
+    int64_t value = parse_number(text);
+    if (value < 0) {
+        throw std::invalid_argument(text);
+    }
+    return value;
+}
+
+static Price parse_price(const std::string& text) {
+    int64_t value = parse_number(text);
+    if (value != static_cast<Price>(value)) {
+        throw std::out_of_range(text);
+    }
+    return value;
+}
+
+// Widest price range an imported market is given dense storage for
+static constexpr int MAX_DENSE = 1 << 20;
+
+// Bounds seen for an asset while importing
+struct PriceRange {
+    int min = 0;
+    int max = 0;
+    bool seen = false;
+};
+
+// Reads a CSV of commands and writes them out as a replay file
+static void import_csv(const std::string& csv, const std::string& path, const std::vector<Market>& declared) {
+    std::ifstream in(csv);
+    if (!in) {
+        fail("open " + csv);
+    }
+    Interner assets;
+    Interner users;
+    std::vector<PriceRange> ranges;
+    std::unordered_map<std::string, uint64_t> order_ids; // CSV order id to replay order id
+    std::vector<uint32_t> order_assets; // By replay order id
+    std::vector<ReplayCommand> commands;
+    uint64_t skipped = 0;
+
+    std::string line;
+    for (uint64_t number = 1; std::getline(in, line); number++) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        std::vector<std::string> fields = split(line);
+        if (line.empty() || line[0] == '#' || (number == 1 && fields[0] == "action")) {
+            continue;
+        }
+        fields.resize(std::max<size_t>(fields.size(), 7));
+        const std::string& action = fields[0];
+        ReplayCommand command{};
+        try {
+            if (action == "limit" || action == "market") {
+                if (fields[4] != "buy" && fields[4] != "sell") {
+                    throw std::invalid_argument(fields[4]);
+                }
+                if (fields[3].empty() || fields[3].size() >= REPLAY_NAME_SIZE) {
+                    throw std::runtime_error("replay: line " + std::to_string(number) + ": asset name must be 1 to " + std::to_string(REPLAY_NAME_SIZE - 1) + " characters");
+                }
+                command.action = action == "limit" ? REPLAY_LIMIT : REPLAY_MARKET;
+                command.user = users.intern(fields[2]);
+                command.asset = assets.intern(fields[3]);
+                command.direction = fields[4] == "buy" ? BUY : SELL;
+                command.quantity = parse_quantity(fields[5]);
+                command.price = command.action == REPLAY_LIMIT ? parse_price(fields[6]) : 0;
+                command.order_id = order_assets.size();
+                order_ids[fields[1]] = command.order_id;
+                order_assets.push_back(command.asset);
+            } else if (action == "cancel" || action == "modify") {
+                auto it = order_ids.find(fields[1]);
+                if (it == order_ids.end()) {
+                    skipped++; // Placed before the recording started, so its book is unknown
+                    continue;
+                }
+                command.action = action == "cancel" ? REPLAY_CANCEL : REPLAY_MODIFY;
+                command.order_id = it->second;
+                command.asset = order_assets[it->second];
+                if (command.action == REPLAY_MODIFY) {
+                    command.quantity = parse_quantity(fields[5]);
+                    command.price = parse_price(fields[6]);
+                }
+            } else {
+                throw std::runtime_error("replay: line " + std::to_string(number) + ": unknown action " + action);
+            }
+        } catch (const std::logic_error& e) {
+            throw std::runtime_error("replay: line " + std::to_string(number) + ": malformed command");
+        }
+        if (command.action == REPLAY_LIMIT || command.action == REPLAY_MODIFY) {
+            ranges.resize(assets.get_size());
+            PriceRange& range = ranges[command.asset];
+            range.min = range.seen ? std::min(range.min, command.price) : command.price;
+            range.max = range.seen ? std::max(range.max, command.price) : command.price;
+            range.seen = true;
+        }
+        commands.push_back(command);
+    }
+    ranges.resize(assets.get_size());
+
+    std::vector<ReplayMarket> markets(assets.get_size());
+    for (uint32_t asset = 0; asset < markets.size(); asset++) {
+        const std::string& name = assets.get_name(asset);
+        ReplayMarket& market = markets[asset];
+        std::memcpy(market.name, name.data(), name.size());
+        auto it = std::find_if(declared.begin(), declared.end(), [&](const Market& m) { return m.name == name; });
+        if (it != declared.end()) {
+            market.min = it->min;
+            market.max = it->max;
+            market.tick = it->tick;
+            market.storage = it->storage;
+        } else {
+            market.min = ranges[asset].min;
+            market.max = std::max(ranges[asset].max, ranges[asset].min + 1);
+            market.tick = 1;
+            market.storage = static_cast<int64_t>(market.max) - market.min > MAX_DENSE ? PAGED : DENSE;
+        }
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fail("create " + path);
+    }
+    Writer out(fd);
+    ReplayHeader header{};
+    std::memcpy(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    header.version = REPLAY_VERSION;
+    header.markets = markets.size();
+    header.commands = commands.size();
+    out.put(&header, sizeof(header));
+    out.put(markets.data(), markets.size() * sizeof(ReplayMarket));
+    out.put(commands.data(), commands.size() * sizeof(ReplayCommand));
+    out.flush();
+    ::close(fd);
+
+    std::cout << "Imported " << commands.size() << " commands for " << markets.size() << " assets and "
+              << users.get_size() << " users, skipped " << skipped << " for unknown orders" << std::endl;
+    for (const ReplayMarket& market : markets) {
+        std::cout << "  " << market.name << " [" << market.min << ", " << market.max << "]"
+                  << (market.storage == PAGED ? " paged" : "") << (market.tick > 1 ? " tick " + std::to_string(market.tick) : "") << std::endl;
+    }
+}
+
+struct ReplayStats {
+    uint64_t commands = 0;
+    uint64_t rejected = 0; // Off the book's price bounds or tick, as the server would refuse them
+    uint64_t missed = 0; // Cancels and modifies for orders no longer resting
+    uint64_t fills = 0;
+};
+
+// Last touch written out for a book
+struct Touch {
+    int bid = 0;
+    int ask = 0;
+    uint64_t bid_quantity = 0;
+    uint64_t ask_quantity = 0;
+    bool operator==(const Touch& other) const {
+        return this->bid == other.bid && this->ask == other.ask &&
+            this->bid_quantity == other.bid_quantity && this->ask_quantity == other.ask_quantity;
+    }
+};
+
+// Whether a limit or modify price is one the server would take for the book
+static bool valid_price(Engine& engine, uint32_t asset, int price) {
+    return price >= engine.get_min_price(asset) && price <= engine.get_max_price(asset) && price % engine.get_tick(asset) == 0;
+}
+
+// Replays the commands for `assets` through an Engine of their own, writing events to `out` if set
+static void replay_assets(const ReplayFile& file, const std::vector<uint32_t>& assets, Writer* out, ReplayStats& stats) {
+    const ReplayHeader& header = file.get_header();
+    const ReplayMarket* markets = file.get_markets();
+    const ReplayCommand* commands = file.get_commands();
+    std::vector<Market> own;
+    std::vector<int> local(header.markets, -1); // File asset to this Engine's asset id
+    for (uint32_t asset : assets) {
+        const ReplayMarket& market = markets[asset];
+        local[asset] = own.size();
+        own.push_back(Market{std::string(market.name, strnlen(market.name, REPLAY_NAME_SIZE)), market.min, market.max, static_cast<Storage>(market.storage), market.tick});
+    }
+    Engine engine(own, 0);
+    std::vector<Touch> touches(own.size());
+    std::vector<Fill> fills;
+
+    for (uint64_t i = 0; i < header.commands; i++) {
+        const ReplayCommand& command = commands[i];
+        if (command.asset >= header.markets || local[command.asset] < 0) {
+            continue;
+        }
+        uint32_t asset = local[command.asset];
+        stats.commands++;
+        fills.clear();
+        if (command.action == REPLAY_LIMIT || command.action == REPLAY_MARKET) {
+            Order order{command.order_id, command.quantity, command.price, command.user, asset, command.direction == SELL};
+            bool market = command.action == REPLAY_MARKET;
+            if (
+                order.order_id > OrderLocations::MAX_ID || order.quantity == 0 || order.quantity > MAX_QUANTITY ||
+                (!market && !valid_price(engine, asset, order.price))
+            ) {
+                stats.rejected++;
+                continue;
+            }
+            // Sizes market orders the way the server's do
+            if (engine.place_order(order, fills, market) != REJECT_NONE) {
+                stats.rejected++;
+                continue;
+            }
+        } else if (command.action == REPLAY_CANCEL) {
+            if (!engine.cancel_order(command.order_id)) {
+                stats.missed++;
+            }
+        } else if (command.action == REPLAY_MODIFY) {
+            if (command.quantity > MAX_QUANTITY || !valid_price(engine, asset, command.price)) {
+                stats.rejected++;
+                continue;
+            }
+            RejectReason reason;
+            if (!engine.modify_order(command.order_id, command.quantity, command.price, fills, reason)) {
+                if (reason != REJECT_NONE) {
+                    stats.rejected++;
+                    continue;
+                }
+                stats.missed++;
+            }
+        } else {
+            stats.rejected++;
+            continue;
+        }
+        stats.fills += fills.size();
+        if (!out) {
+            continue;
+        }
+
+        for (const Fill& fill : fills) {
+            ReplayFill event{};
+            event.type = EVENT_FILL;
+            event.aggressor = fill.aggressor;
+            event.asset = command.asset;
+            event.command = i;
+            event.maker_order_id = fill.maker_order_id;
+            event.taker_order_id = fill.taker_order_id;
+            event.quantity = fill.quantity;
+            event.price = fill.price;
+            out->put(&event, sizeof(event));
+        }
+        BookTop top = engine.get_top(asset);
+        Touch touch{top.hi_bid, top.lo_ask, top.bid_count ? top.bids[0].quantity : 0, top.ask_count ? top.asks[0].quantity : 0};
+        if (!(touch == touches[asset])) {
+            touches[asset] = touch;
+            ReplayTop event{};
+            event.type = EVENT_TOP;
+            event.asset = command.asset;
+            event.command = i;
+            event.bid = touch.bid;
+            event.ask = touch.ask;
+            event.bid_quantity = touch.bid_quantity;
+            event.ask_quantity = touch.ask_quantity;
+            out->put(&event, sizeof(event));
+        }
+    }
+    if (out) {
+        out->flush();
+    }
+}
+
+// Replays a file, splitting its assets across `threads` threads by how many commands each has
+static void run(const std::string& path, const std::string& output, int threads) {
+    ReplayFile file(path);
+    const ReplayHeader& header = file.get_header();
+    std::vector<uint64_t> counts(header.markets, 0);
+    for (uint64_t i = 0; i < header.commands; i++) {
+        uint32_t asset = file.get_commands()[i].asset;
+        if (asset < header.markets) {
+            counts[asset]++;
+        }
+    }
+
+    // Busiest assets first, each to the least loaded thread
+    threads = std::max(1, std::min<int>(threads, header.markets));
+    std::vector<uint32_t> order(header.markets);
+    for (uint32_t asset = 0; asset < header.markets; asset++) {
+        order[asset] = asset;
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return counts[a] > counts[b]; });
+    std::vector<std::vector<uint32_t>> shares(threads);
+    std::vector<uint64_t> loads(threads, 0);
+    for (uint32_t asset : order) {
+        size_t least = std::min_element(loads.begin(), loads.end()) - loads.begin();
+        shares[least].push_back(asset);
+        loads[least] += counts[asset];
+    }
+
+    int fd = -1;
+    std::mutex lock;
+    std::vector<std::unique_ptr<Writer>> writers(threads);
+    if (!output.empty()) {
+        fd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            fail("create " + output);
+        }
+        for (auto& writer : writers) {
+            writer = std::make_unique<Writer>(fd, &lock);
+        }
+    }
+
+    std::vector<ReplayStats> stats(threads);
+    std::vector<std::string> failures(threads);
+    std::vector<std::thread> workers;
+    uint64_t start = now_ns();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            try {
+                replay_assets(file, shares[t], writers[t].get(), stats[t]);
+            } catch (const std::exception& e) {
+                failures[t] = e.what();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    uint64_t elapsed = now_ns() - start;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    for (const std::string& failure : failures) {
+        if (!failure.empty()) {
+            throw std::runtime_error(failure);
+        }
+    }
+
+    ReplayStats total;
+    for (const ReplayStats& s : stats) {
+        total.commands += s.commands;
+        total.rejected += s.rejected;
+        total.missed += s.missed;
+        total.fills += s.fills;
+    }
+    std::cout << total.commands << " commands over " << header.markets << " assets on " << threads << " threads in "
+              << elapsed / 1e9 << " s: " << total.commands * 1e9 / elapsed << " orders/s" << std::endl;
+    std::cout << total.fills << " fills, " << total.rejected << " rejected, " << total.missed << " cancels and modifies missed" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string usage = "Usage: " + std::string(argv[0]) + " import <csv> <replay file> [--market <ticker> <min> <max> [dense|paged] [tick <size>]]...\n"
+                        "       " + std::string(argv[0]) + " run <replay file> [--out <events file>] [--threads <n>]";
+    if (argc < 3 || (std::string(argv[1]) != "import" && std::string(argv[1]) != "run")) {
+        std::cerr << usage << std::endl;
+        return 1;
+    }
+    std::string mode = argv[1];
+    try {
+        if (mode == "import") {
+            if (argc < 4) {
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+            std::vector<Market> markets;
+            for (int i = 4; i < argc; i++) {
+                if (std::string(argv[i]) != "--market" || i + 3 >= argc) {
+                    std::cerr << "Error: Unknown argument " << argv[i] << std::endl;
+                    std::cerr << usage << std::endl;
+                    return 1;
+                }
+                Market market{argv[i + 1], std::stoi(argv[i + 2]), std::stoi(argv[i + 3])};
+                i += 3;
+                if (i + 1 < argc && (std::string(argv[i + 1]) == "dense" || std::string(argv[i + 1]) == "paged")) {
+                    market.storage = std::string(argv[++i]) == "paged" ? PAGED : DENSE;
+                }
+                if (i + 2 < argc && std::string(argv[i + 1]) == "tick") {
+                    market.tick = std::stoi(argv[i + 2]);
+                    i += 2;
+                }
+                if (market.min >= market.max || market.tick < 1 || market.tick > market.max - market.min) {
+                    std::cerr << "Error: Bad bounds or tick size for `" << market.name << "`" << std::endl;
+                    return 1;
+                }
+                markets.push_back(market);
+            }
+            import_csv(argv[2], argv[3], markets);
+        } else {
+            std::string output;
+            int threads = 1;
+            for (int i = 3; i < argc; i++) {
+                std::string flag = argv[i];
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: No value specified after " << flag << std::endl;
+                    std::cerr << usage << std::endl;
+                    return 1;
+                }
+                if (flag == "--out") {
+                    output = argv[++i];
+                } else if (flag == "--threads") {
+                    threads = std::stoi(argv[++i]);
+                } else {
+                    std::cerr << "Error: Unknown flag " << flag << std::endl;
+                    std::cerr << usage << std::endl;
+                    return 1;
+                }
+            }
+            run(argv[2], output, threads);
+        }
+    } catch (const std::logic_error& e) {
+        std::cerr << "Error: Not a valid number in the arguments" << std::endl;
+        return 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
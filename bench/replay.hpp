@@ -0,0 +1,89 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// File formats of orderbook_replay, little-endian structs written back to back.
+//
+// Input: a ReplayHeader, its `markets` ReplayMarkets, then `commands` ReplayCommands in the order
+// they arrived. Order ids are numbered from 0 in arrival order, as the server would have given
+// them. Cancels and modifies carry the asset of the order they name, so each asset's commands
+// can be replayed apart from the rest.
+//
+// Output: events, each starting with its type byte. A ReplayFill goes out for every fill, and a
+// ReplayTop whenever a command moves a book's touch. One asset's events stay in command order.
+
+constexpr char REPLAY_MAGIC[8] = {'O', 'B', 'R', 'E', 'P', 'L', 'A', 'Y'};
+constexpr uint32_t REPLAY_VERSION = 1;
+constexpr size_t REPLAY_NAME_SIZE = 32;
+
+enum ReplayAction : uint8_t {
+    REPLAY_LIMIT,
+    REPLAY_MARKET, // Capped at the depth it can reach and priced at the far bound, like the server does
+    REPLAY_CANCEL,
+    REPLAY_MODIFY, // New quantity and price; 0 quantity cancels
+};
+
+enum ReplayEventType : uint8_t {
+    EVENT_FILL,
+    EVENT_TOP,
+};
+
+struct ReplayHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t markets;
+    uint64_t commands;
+};
+
+struct ReplayMarket {
+    char name[REPLAY_NAME_SIZE]; // NUL-padded
+    int32_t min;
+    int32_t max;
+    int32_t tick;
+    uint32_t storage; // DENSE or PAGED
+};
+
+struct ReplayCommand {
+    uint64_t order_id;
+    uint64_t quantity; // Unused for cancels
+    int32_t price; // Unused for cancels and market orders
+    uint32_t user;
+    uint32_t asset; // Index into the file's markets
+    uint8_t action; // ReplayAction
+    uint8_t direction; // BUY or SELL; unused for cancels and modifies
+    uint16_t reserved;
+};
+
+struct ReplayFill {
+    uint8_t type; // EVENT_FILL
+    uint8_t aggressor; // Taker's direction
+    uint16_t reserved;
+    uint32_t asset;
+    uint64_t command; // Index of the command that caused it
+    uint64_t maker_order_id;
+    uint64_t taker_order_id;
+    uint64_t quantity;
+    int32_t price;
+    uint32_t padding;
+};
+
+struct ReplayTop {
+    uint8_t type; // EVENT_TOP
+    uint8_t reserved[3];
+    uint32_t asset;
+    uint64_t command; // Index of the command that moved it
+    int32_t bid; // Best bid and ask as the book holds them, whatever it uses for an empty side
+    int32_t ask;
+    uint64_t bid_quantity; // 0 for an empty side
+    uint64_t ask_quantity;
+};
+
+static_assert(sizeof(ReplayHeader) == 24, "ReplayHeader layout is part of the file format");
+static_assert(sizeof(ReplayMarket) == 48, "ReplayMarket layout is part of the file format");
+static_assert(sizeof(ReplayCommand) == 32, "ReplayCommand layout is part of the file format");
+static_assert(sizeof(ReplayFill) == 48, "ReplayFill layout is part of the file format");
+static_assert(sizeof(ReplayTop) == 40, "ReplayTop layout is part of the file format");
+
+#endif // REPLAY_H
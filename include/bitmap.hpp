@@ -0,0 +1,23 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical bitset: each bit on level n+1 marks a non-zero word on level n,
+// so the nearest set bit in either direction is a handful of word scans away
+class Bitmap {
+public:
+    Bitmap(size_t size);
+    void set(size_t pos);
+    void clear(size_t pos);
+    bool test(size_t pos);
+    int64_t find_next(size_t pos);
+    int64_t find_prev(size_t pos);
+
+private:
+    std::vector<std::vector<uint64_t>> levels; // levels[0] holds one bit per position
+};
+
+#endif // BITMAP_H
@@ -1,35 +1,103 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <vector>
+#include "feed.hpp"
+#include "histogram.hpp"
+#include "intern.hpp"
+#include "journal.hpp"
+#include "locations.hpp"
 #include "orderbook.hpp"
+#include "protocol.hpp"
+#include "shard.hpp"
+#include "snapshot.hpp"
 
 struct Market {
     std::string name;
     int min;
     int max;
+    Storage storage = DENSE;
+    int tick = 1; // Limit prices must be a multiple of this
 };
 
+enum BatchAction {BATCH_LIMIT, BATCH_MARKET, BATCH_CANCEL};
+
+// One command of a batch, filled in with its outcome once the batch has run
+struct BatchEntry {
+    BatchAction action;
+    Order order; // Cancels only set order_id; the cancelled order is written back here
+    bool done = false; // Placed, or cancelled an order that was still resting
+    RejectReason reason = REJECT_NONE; // Why a placement was refused, e.g. REJECT_UNKNOWN_BOOK if its book was gone
+    size_t first_fill = 0; // Where this entry's fills start in the batch's fills
+    size_t fill_count = 0;
+};
+
+// Owns every orderbook. With shards > 0 books are spread across that many matching threads
+// and all book access is routed through the owning shard; with 0 it all runs inline.
 class Engine {
 public:
     Engine();
-    Engine(const std::vector<Market>& markets);
+    Engine(const std::vector<Market>& markets, int shards = 0, size_t depth = Orderbook::DEFAULT_DEPTH, const std::vector<int>& cores = {}, bool busy_poll = false);
     void add_orderbook(const Market& market);
     void remove_orderbook(const std::string& asset);
     bool orderbook_exists(const std::string& asset);
-    uint64_t get_buy_depth(const std::string& asset);
-    uint64_t get_sell_depth(const std::string& asset);
-    int get_min_price(const std::string& asset);
-    int get_max_price(const std::string& asset);
-    std::optional<Order> cancel_order(int order_id);
-    std::vector<Order> place_order(Order& order);
-    std::unordered_map<int, int> get_orders(bool direction, const std::string& asset, int price);
+    std::optional<uint32_t> get_asset_id(const std::string& asset);
+    std::string get_asset_name(uint32_t asset);
+    uint64_t get_buy_depth(uint32_t asset);
+    uint64_t get_sell_depth(uint32_t asset);
+    int get_min_price(uint32_t asset);
+    int get_max_price(uint32_t asset);
+    int get_tick(uint32_t asset);
+    std::optional<Order> cancel_order(uint64_t order_id);
+    std::optional<Order> modify_order(uint64_t order_id, uint64_t quantity, Price price, std::vector<Fill>& fills, RejectReason& reason);
+    std::optional<uint32_t> get_order_asset(uint64_t order_id);
+    void cancel_user(uint32_t user, std::optional<uint32_t> asset, std::vector<Order>& cancelled);
+    RejectReason place_order(Order& order, std::vector<Fill>& fills, bool market = false);
+    void run_batch(std::vector<BatchEntry>& batch, std::vector<Fill>& fills);
+    std::unordered_map<int, uint64_t> get_orders(bool direction, uint32_t asset, int price);
+    size_t get_depth_limit();
+    BookTop get_top(uint32_t asset);
+    void get_latency(Histogram& latency);
+    void get_queue_depths(std::vector<size_t>& depths);
+    size_t get_location_bytes();
+    void set_journal(Journal* journal);
+    void set_feed(Feed* feed);
+    void set_on_remove(std::function<void(uint32_t)> on_remove);
+    uint64_t get_levels(uint32_t asset, std::vector<LevelDelta>& levels);
+    void restore(const RecordHeader& header, const char* payload);
+    uint64_t capture(std::vector<std::string>& assets, std::vector<BookImage>& books);
+    void load(const std::vector<std::string>& assets, const std::vector<BookView>& books);
 
 private:
-    std::unordered_map<int, std::string> id_to_asset;
-    std::unordered_map<std::string, Orderbook> orderbooks;
-    Orderbook& get_orderbook(const std::string& name);
+    std::shared_mutex directory_lock; // Guards `assets` and `orderbooks`, not the books themselves
+    Interner assets; // Asset names to ids
+    OrderLocations locations; // Where every resting order is; outlives the books writing to it
+    std::vector<std::unique_ptr<Orderbook>> orderbooks; // Indexed by asset id, null once removed
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::mutex inline_lock; // Serialises book access when there are no shards
+    size_t depth = Orderbook::DEFAULT_DEPTH; // Levels per side in each book's depth view
+    Journal* journal = nullptr; // Records every change to the books, if set
+    std::vector<uint64_t> loaded_seq; // Per asset, the journal seq its snapshot covers
+    Feed* feed = nullptr; // Receives every book's level changes, if set
+    std::function<void(uint32_t)> on_remove; // Told the asset of each book removed, if set
+    Orderbook* get_orderbook(uint32_t asset);
+    void size_market(Orderbook& book, Order& order);
+    uint64_t run_entry(Orderbook& book, BatchEntry& entry, std::vector<Fill>& fills);
+    void resolve_batch(std::vector<BatchEntry>& batch);
+    uint64_t log_order(const Order& order);
+    uint64_t log_cancel(uint64_t order_id);
+    uint64_t log_modify(uint64_t order_id, uint64_t quantity, Price price);
+    uint64_t cancel_user_in(Orderbook& book, uint32_t asset, uint32_t user, std::vector<Order>& cancelled);
+    void publish_levels(Orderbook& book, uint32_t asset);
+    void copy_book(Orderbook& book, uint32_t asset, BookImage& image);
+    template <typename F>
+    auto execute(uint32_t asset, F fn) -> decltype(fn(std::declval<Orderbook&>()));
 };
 
 #endif // ENGINE_H
@@ -0,0 +1,67 @@
+#ifndef FEED_H
+#define FEED_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "orderbook.hpp"
+
+// One book's changed levels after a command: `count` entries of FeedBatch::levels from `first`
+struct FeedUpdate {
+    uint32_t asset;
+    uint64_t seq; // The book's level sequence after the change
+    uint32_t first;
+    uint32_t count;
+};
+
+// Updates handed to the sender together, oldest first
+struct FeedBatch {
+    std::vector<FeedUpdate> updates;
+    std::vector<LevelDelta> levels;
+};
+
+// Moves level changes off the matching threads. Shards publish each command's deltas into a
+// buffer; every millisecond a single thread hands whatever has built up to `deliver`, so a busy
+// book costs one wakeup per interval rather than one per command. It also calls `refresh` with
+// the assets that need a full book: those just subscribed to and, every refresh interval, all
+// of them, so a consumer that missed a delta catches up.
+class Feed {
+public:
+    Feed(
+        std::function<void(const FeedBatch&)> deliver,
+        std::function<void(const std::vector<uint32_t>&)> refresh,
+        int refresh_interval = 5,
+        size_t max_pending = 1 << 20
+    );
+    ~Feed();
+    void publish(uint32_t asset, uint64_t seq, const std::vector<LevelDelta>& levels);
+    void subscribe(uint32_t asset);
+    void unsubscribe(uint32_t asset);
+    bool is_active();
+    uint64_t get_dropped();
+
+private:
+    static constexpr int FLUSH_INTERVAL_US = 1000;
+    static constexpr size_t FLUSH_LEVELS = 4096; // Wake the sender early once this many are pending
+    std::function<void(const FeedBatch&)> deliver;
+    std::function<void(const std::vector<uint32_t>&)> refresh;
+    int refresh_interval; // Seconds between full books, 0 to only send them on subscribe
+    size_t max_pending; // Levels buffered before updates are dropped
+    std::atomic<int> subscribers; // Read without the lock so idle books skip it
+    std::mutex lock; // Guards everything below
+    std::condition_variable wake;
+    std::unordered_map<uint32_t, int> counts; // Subscribers per asset
+    std::vector<uint32_t> refreshing; // Assets owed a full book
+    FeedBatch pending;
+    uint64_t dropped;
+    bool running;
+    std::thread sender;
+    void run();
+};
+
+#endif // FEED_H
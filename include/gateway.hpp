@@ -0,0 +1,50 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "engine.hpp"
+#include "protocol.hpp"
+
+class Server;
+
+// Serves the binary protocol in protocol.hpp on its own TCP port. One thread multiplexes every
+// session with epoll and pushes orders through the same entry points as the REST API.
+class Gateway {
+public:
+    Gateway(int port, Server& server, Engine& engine, bool cancel_on_disconnect = false, bool busy_poll = false);
+    ~Gateway();
+    void publish(const Fill& fill);
+    void stop();
+
+private:
+    struct Session {
+        std::optional<uint32_t> user; // Set once logged in
+        std::vector<char> buffer; // Bytes received but not yet framed
+    };
+    int port;
+    Server& server;
+    Engine& engine;
+    bool cancel_on_disconnect; // Cancel a user's resting orders once their last session closes
+    bool busy_poll; // Poll sockets without blocking, trading a core for the wakeup latency
+    int listener; // Listening socket
+    int epoll; // Readiness for the listener, the wakeup pipe and every session
+    int wakeup[2]; // Written to on shutdown to break out of epoll_wait
+    std::atomic<bool> running;
+    std::unordered_map<int, Session> sessions; // By socket, gateway thread only
+    std::mutex lock; // Serialises writes to sessions and guards `user_sessions`
+    std::unordered_multimap<uint32_t, int> user_sessions; // Logged in sockets per user
+    std::thread thread;
+    void run();
+    void accept_session();
+    bool read_session(int fd, Session& session);
+    bool handle(int fd, Session& session, const char* message, uint8_t type, size_t length);
+    void send(int fd, const void* message, size_t length);
+    void close_session(int fd);
+};
+
+#endif // GATEWAY_H
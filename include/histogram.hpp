@@ -0,0 +1,32 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Log-linear latency histogram: 16 linear buckets per power of two, so every recorded
+// value is kept to within ~6%. Written by one thread, readable from any.
+class Histogram {
+public:
+    Histogram();
+    void record(uint64_t value);
+    void merge(Histogram& other);
+    uint64_t get_count();
+    uint64_t get_max();
+    uint64_t get_sum();
+    uint64_t percentile(double p);
+
+private:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int BUCKETS = 64 * SUB_BUCKETS;
+    std::array<std::atomic<uint64_t>, BUCKETS> counts;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> sum;
+    static int bucket(uint64_t value);
+    static uint64_t bucket_value(int bucket);
+};
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,23 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Maps names to dense integer ids and back; ids are never reused
+class Interner {
+public:
+    uint32_t intern(const std::string& name);
+    std::optional<uint32_t> find(const std::string& name);
+    const std::string& get_name(uint32_t id);
+    size_t get_size();
+
+private:
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> names;
+};
+
+#endif // INTERN_H
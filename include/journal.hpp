@@ -0,0 +1,107 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How long an acknowledged command may sit outside stable storage
+enum Durability {
+    DURABLE_NONE, // Written from memory every interval, never fsynced
+    DURABLE_BATCH, // Fsynced every interval; replies don't wait for it
+    DURABLE_SYNC, // Replies wait for the fsync covering their record, shared with everyone queued alongside
+};
+
+enum RecordType : uint8_t {
+    RECORD_USER,
+    RECORD_BOOK,
+    RECORD_REMOVE,
+    RECORD_ORDER,
+    RECORD_CANCEL,
+    RECORD_MODIFY,
+    RECORD_CANCEL_USER,
+};
+
+// Precedes every record's payload in a segment
+struct RecordHeader {
+    uint64_t seq; // Strictly increasing across segments
+    uint32_t checksum; // Over the rest of the header and the payload
+    uint16_t length; // Payload bytes
+    RecordType type;
+    uint8_t reserved;
+};
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader should stay 16 bytes");
+
+// Payload of RECORD_USER, followed by the name and then the callback URL
+struct UserRecord {
+    uint32_t name_length;
+};
+
+// Payload of RECORD_BOOK, followed by the asset name. RECORD_REMOVE is just the name.
+struct BookRecord {
+    int32_t min;
+    int32_t max;
+    uint32_t storage;
+    int32_t tick;
+};
+
+// RECORD_ORDER's payload is the Order as it was handed to the book; RECORD_CANCEL's is the order id
+
+// Payload of RECORD_MODIFY
+struct ModifyRecord {
+    uint64_t order_id;
+    uint64_t quantity;
+    int32_t price;
+    uint32_t reserved;
+};
+
+// Payload of RECORD_CANCEL_USER, written once per book a mass cancel took orders from
+struct UserCancelRecord {
+    uint32_t user;
+    uint32_t asset;
+};
+
+// Write-ahead log of every command that changes engine or user state, kept as a directory of
+// append-only segment files named after the first sequence number they hold. Appends only copy
+// into memory; a background thread writes them out and fsyncs, so one write and one fsync
+// cover every record that arrived in the meantime (group commit).
+class Journal {
+public:
+    Journal(const std::string& directory, Durability durability = DURABLE_BATCH);
+    ~Journal();
+    uint64_t append(RecordType type, const void* payload, size_t length);
+    void commit(uint64_t seq);
+    void replay(uint64_t after, const std::function<void(const RecordHeader&, const char*)>& apply);
+    void discard(uint64_t seq);
+    uint64_t get_last_seq();
+    Durability get_durability();
+    const std::string& get_directory();
+
+private:
+    static constexpr size_t SEGMENT_BYTES = 256 << 20; // Roll to a new file past this size
+    static constexpr size_t FLUSH_BYTES = 1 << 20; // Wake the writer early once this much is pending
+    static constexpr int FLUSH_INTERVAL_US = 1000;
+    std::string directory;
+    Durability durability;
+    int fd; // Segment being appended to
+    size_t segment_size;
+    std::mutex lock; // Guards everything below
+    std::condition_variable wake; // Writer waits here for work
+    std::condition_variable flushed; // Committers wait here for `durable` to move
+    std::vector<char> pending; // Records appended since the last write
+    uint64_t next_seq;
+    uint64_t durable; // Last seq written out (and fsynced, unless DURABLE_NONE)
+    int waiting; // Committers blocked in commit()
+    bool running;
+    std::thread writer;
+    std::vector<std::string> list_segments();
+    void open_segment(uint64_t first_seq);
+    size_t scan_segment(const std::string& path, uint64_t after, const std::function<void(const RecordHeader&, const char*)>* apply, uint64_t& last_seq);
+    void run();
+};
+
+#endif // JOURNAL_H
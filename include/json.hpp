@@ -0,0 +1,56 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// The keys of one kind of JSON object, pre-rendered as "name": fragments. Crow writes an
+// object's keys in its map's iteration order rather than the order they were set, so a shape
+// works that order out once, letting hand-written replies match crow::json::wvalue byte for byte.
+class JsonShape {
+public:
+    JsonShape(std::initializer_list<const char*> keys); // In the order a wvalue would have set them
+    const size_t* begin() const;
+    const size_t* end() const;
+    const std::string& key(size_t field) const;
+
+private:
+    std::vector<std::string> keys; // Indexed by field, each quoted and followed by ':'
+    std::vector<size_t> order; // Fields in the order Crow would write them
+};
+
+// Writes JSON straight onto the end of a string, with no whitespace, integers as std::to_string
+// prints them and strings escaped like crow::json::escape. Callers keep the string per thread
+// and clear it between replies, so once it has grown nothing here allocates.
+class JsonWriter {
+public:
+    JsonWriter(std::string& out);
+    void begin_object();
+    void end_object();
+    void begin_array();
+    void end_array();
+    void key(const JsonShape& shape, size_t field);
+    void key(int64_t name);
+    void value(uint64_t number);
+    void value(int64_t number);
+    void value(uint32_t number);
+    void value(int32_t number);
+    void value(const std::string& text);
+    void value(const char* text);
+    void null();
+
+private:
+    static constexpr int MAX_NESTING = 8;
+    std::string& out;
+    bool first[MAX_NESTING + 1]; // Per open object or array, whether nothing is in it yet
+    int nesting = 0;
+    bool keyed = false; // A key was just written, so its value needs no comma
+    void separate();
+    void append_number(uint64_t number);
+    void append_number(int64_t number);
+    void append_string(const char* text, size_t size);
+};
+
+#endif // JSON_H
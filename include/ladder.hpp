@@ -0,0 +1,45 @@
+#ifndef LADDER_H
+#define LADDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "bitmap.hpp"
+#include "queue.hpp"
+#include "runtime.hpp"
+
+// How a market's price levels are backed
+enum Storage {
+    DENSE, // Every level allocated up front, in one block
+    PAGED, // Pages of levels allocated when first used and returned once empty
+};
+
+// Price levels indexed by tick offset from the book's min price, stored in fixed-size pages
+class Ladder {
+public:
+    Ladder(size_t size, Storage storage);
+    Queue& at(size_t idx);
+    void occupy(size_t idx);
+    void vacate(size_t idx);
+    bool is_occupied(size_t idx);
+    int64_t find_next(size_t idx);
+    int64_t find_prev(size_t idx);
+    Storage get_storage();
+    size_t get_pages();
+
+private:
+    static constexpr size_t PAGE_BITS = 10;
+    static constexpr size_t PAGE_SIZE = 1 << PAGE_BITS; // Levels per page
+    static constexpr size_t MAX_SPARE = 4; // Empty pages kept around to absorb churn at a page boundary
+    Storage storage;
+    size_t live_pages; // Pages currently materialised
+    std::vector<Queue, PageAllocator<Queue>> levels; // Every level of a DENSE ladder
+    std::vector<std::unique_ptr<Queue[]>> pages; // PAGED only, null until a level in the page is used
+    std::vector<uint32_t> counts; // Non-empty levels per page
+    std::vector<std::unique_ptr<Queue[]>> spare; // Recycled empty pages
+    Bitmap occupied; // One bit per non-empty level
+    Queue* new_page();
+};
+
+#endif // LADDER_H
@@ -0,0 +1,71 @@
+#ifndef LOCATIONS_H
+#define LOCATIONS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// Where a resting order is: its book's asset id and its node in that book's pool
+struct Location {
+    uint32_t asset;
+    uint32_t node;
+};
+
+// Locations of resting orders indexed directly by order id, with no hashing. Ids are handed out
+// densely, so the table is a tree of fixed-size pages, allocated when the first order in their
+// range rests. A page is recycled once every order in it has left its book and later ids have
+// moved on. Books write their own orders' entries from their matching thread; any thread may
+// look one up. Setting, taking and finding entries take no lock, only adding or recycling a page
+// does, and a table only one thread ever touches skips even that.
+class OrderLocations {
+public:
+    static constexpr uint64_t MAX_ID = (1ULL << 48) - 1; // Ids above this can't rest
+    OrderLocations(bool concurrent = true);
+    ~OrderLocations();
+    OrderLocations(const OrderLocations&) = delete;
+    OrderLocations& operator=(const OrderLocations&) = delete;
+    void set(uint64_t order_id, uint32_t asset, uint32_t node);
+    std::optional<Location> take(uint64_t order_id, uint32_t asset);
+    std::optional<Location> find(uint64_t order_id);
+    size_t get_pages();
+    size_t get_bytes();
+
+private:
+    static constexpr int PAGE_BITS = 12; // 4096 ids, 32 KiB of entries
+    static constexpr int DIRECTORY_BITS = 14; // Pages per directory, so 64M ids each
+    static constexpr int VOLUME_BITS = 11; // Directories per volume
+    static constexpr int ROOT_BITS = 48 - PAGE_BITS - DIRECTORY_BITS - VOLUME_BITS; // Volumes, enough for MAX_ID
+    static constexpr int INDEX_BITS = 48 - PAGE_BITS;
+    static constexpr uint64_t INDEX_MASK = (1ULL << INDEX_BITS) - 1;
+    static constexpr uint64_t GENERATION = 1ULL << INDEX_BITS;
+    static constexpr uint64_t EMPTY = UINT64_MAX;
+    static constexpr uint32_t DEAD = 1U << 31;
+    static constexpr size_t MAX_SPARE = 4; // Recycled pages a private table keeps rather than frees
+    struct Page {
+        std::atomic<uint64_t> entries[1 << PAGE_BITS]; // Asset in the high half, node in the low
+        std::atomic<uint32_t> live; // Entries set plus writers about to set one, or DEAD once recycled
+        std::atomic<uint64_t> stamp; // Page index, under a generation that's odd while it's spare
+    };
+    struct Directory {
+        std::atomic<Page*> pages[1 << DIRECTORY_BITS] = {};
+    };
+    struct Volume {
+        std::atomic<Directory*> directories[1 << VOLUME_BITS] = {};
+    };
+    bool concurrent; // Whether more than one thread uses the table
+    std::mutex lock; // Held to add or recycle a page
+    std::atomic<Volume*> volumes[1 << ROOT_BITS] = {};
+    std::vector<Page*> spare;
+    std::atomic<uint64_t> last_page; // Highest page an order has rested in
+    size_t pages; // Pages in use
+    Page* find_page(uint64_t index);
+    std::atomic<Page*>& add_slot(uint64_t index);
+    Page* pin_page(uint64_t index);
+    void release_page(Page* page);
+    void recycle_page(Page* page, uint64_t index);
+};
+
+#endif // LOCATIONS_H
@@ -0,0 +1,78 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include "histogram.hpp"
+
+enum MetricCounter {
+    METRIC_ACCEPTED, // Orders that passed validation
+    METRIC_REJECTED, // Orders refused by validation
+    METRIC_FILLS, // Executions between a maker and a taker
+    METRIC_CANCELLED, // Cancels that found their order
+    METRIC_CANCEL_MISSES, // Cancels for orders no longer resting
+    METRIC_MODIFIED, // Modifies that found their order
+    METRIC_MODIFY_MISSES, // Modifies for orders no longer resting
+    METRIC_COUNTERS,
+};
+
+enum MetricSample {
+    METRIC_VALIDATE, // Server::accept_order, in ticks
+    METRIC_PLACE, // Engine::place_order including any wait for the shard, in ticks
+    METRIC_CANCEL, // Orderbook::cancel_order, in ticks
+    METRIC_INFORM, // Server::inform_user, in ticks
+    METRIC_SWEPT, // Price levels an aggressive order took liquidity from
+    METRIC_SAMPLES,
+};
+
+// One thread's counters and samples. Only that thread writes them, so recording is a couple of
+// relaxed loads and stores; a scrape reads them from another thread.
+struct ThreadMetrics {
+    std::atomic<uint64_t> counters[METRIC_COUNTERS] = {};
+    Histogram samples[METRIC_SAMPLES];
+};
+
+// Process-wide instrumentation. Every thread records into its own ThreadMetrics, created on
+// first use and folded into a retired total when the thread exits, so nothing on the hot path
+// takes a lock or shares a cache line. Build with ORDERBOOK_NO_METRICS to compile it all out.
+class Metrics {
+public:
+    static void count(MetricCounter counter, uint64_t n = 1);
+    static void record(MetricSample sample, uint64_t value);
+    static uint64_t ticks();
+    static double ticks_per_ns();
+    static void collect(ThreadMetrics& totals);
+    static ThreadMetrics& local();
+};
+
+// Records the ticks between construction and destruction
+class MetricTimer {
+public:
+    MetricTimer(MetricSample sample) : sample(sample), start(Metrics::ticks()) {}
+    ~MetricTimer() { Metrics::record(this->sample, Metrics::ticks() - this->start); }
+
+private:
+    MetricSample sample;
+    uint64_t start;
+};
+
+inline void Metrics::count(MetricCounter counter, uint64_t n) {
+    std::atomic<uint64_t>& value = Metrics::local().counters[counter];
+    value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void Metrics::record(MetricSample sample, uint64_t value) {
+    Metrics::local().samples[sample].record(value);
+}
+
+#ifdef ORDERBOOK_NO_METRICS
+#define METRIC_COUNT(counter, n)
+#define METRIC_RECORD(sample, value)
+#define METRIC_TIMER(sample)
+#else
+#define METRIC_COUNT(counter, n) Metrics::count(counter, n)
+#define METRIC_RECORD(sample, value) Metrics::record(sample, value)
+#define METRIC_TIMER(sample) MetricTimer metric_timer(sample)
+#endif
+
+#endif // METRICS_H
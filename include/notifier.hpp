@@ -0,0 +1,66 @@
+#ifndef NOTIFIER_H
+#define NOTIFIER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cpr {
+class Session;
+}
+
+// Counters describing how far behind fill callbacks are
+struct NotifierStats {
+    uint64_t pending; // Fills waiting to be sent
+    uint64_t queued; // Fills accepted since startup
+    uint64_t sent; // Fills delivered
+    uint64_t batches; // POSTs that delivered at least one fill
+    uint64_t retries; // POSTs retried after a failure
+    uint64_t failed; // Fills given up on after the last retry
+    uint64_t dropped; // Fills refused because the backlog was full
+};
+
+// Delivers fill callbacks from a pool of worker threads so nothing on the order path waits
+// on a user's endpoint. Fills are queued per user; whatever has piled up for a user by the
+// time a worker gets to them goes out as one POST, and each user has at most one POST in
+// flight so their fills arrive in order.
+class Notifier {
+public:
+    Notifier(int workers = 4, size_t max_pending = 1 << 16, int max_retries = 3);
+    ~Notifier();
+    void notify(uint32_t user, const std::string& url, std::string fill);
+    NotifierStats get_stats();
+
+private:
+    struct UserQueue {
+        std::string url; // Latest callback URL for the user
+        std::vector<std::string> fills; // Serialised fills waiting to go out
+        bool scheduled = false; // User is in `ready`
+        bool in_flight = false; // A worker is posting for this user
+    };
+    size_t max_pending;
+    int max_retries;
+    std::atomic<bool> running;
+    std::mutex lock; // Guards everything below except the counters
+    std::condition_variable wake;
+    std::unordered_map<uint32_t, UserQueue> queues;
+    std::deque<uint32_t> ready; // Users with fills and nothing in flight
+    size_t pending;
+    std::atomic<uint64_t> queued;
+    std::atomic<uint64_t> sent;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> retries;
+    std::atomic<uint64_t> failed;
+    std::atomic<uint64_t> dropped;
+    std::vector<std::thread> workers;
+    void run();
+    bool post(cpr::Session& session, const std::string& url, const std::string& body);
+};
+
+#endif // NOTIFIER_H
@@ -1,20 +1,48 @@
 #ifndef ORDER_H
 #define ORDER_H
 
-#include <string>
+#include <cstdint>
+
+// Prices are fixed point: a whole number of the market's smallest price unit (cents, say).
+// Each market also has a tick size, and only takes limit prices that are a multiple of it.
+typedef int32_t Price;
+
+// Largest quantity one order may have, the most a client reading JSON numbers as doubles gets back
+// exactly. Depths add orders up, so books still check a side's total before an order rests.
+constexpr uint64_t MAX_QUANTITY = (1ULL << 53) - 1;
 
 enum Direction {
     BUY,
     SELL,
 };
 
+// Plain record used everywhere inside the engine; user and asset are interned ids
+// which the server resolves back to names at the HTTP boundary
 struct Order {
-    std::string user;
+    uint64_t order_id;
+    uint64_t quantity;
+    Price price; // Support negative prices 2020 style
+    uint32_t user;
+    uint32_t asset;
     bool direction;
-    std::string asset;
-    int quantity;
-    int price; // Support negative prices 2020 style
-    int order_id;
 };
 
+static_assert(sizeof(Order) == 32, "Order should pack into half a cache line");
+
+// One execution between a resting maker and an incoming taker, both at the maker's price.
+// Exec ids count up per book, so (asset, exec_id) names an execution.
+struct Fill {
+    uint64_t exec_id;
+    uint64_t maker_order_id;
+    uint64_t taker_order_id;
+    uint64_t quantity;
+    Price price;
+    uint32_t maker_user;
+    uint32_t taker_user;
+    uint32_t asset;
+    bool aggressor; // Taker's direction
+};
+
+static_assert(sizeof(Fill) == 56, "Fill should stay under a cache line");
+
 #endif // ORDER_H
@@ -1,32 +1,118 @@
 #ifndef ORDERBOOK_H
 #define ORDERBOOK_H
 
+#include <memory>
+#include <optional>
+#include <utility>
 #include <vector>
-#include <unordered_map>
+#include "ladder.hpp"
+#include "locations.hpp"
 #include "order.hpp"
+#include "pool.hpp"
 #include "queue.hpp"
+#include "seqlock.hpp"
+
+// A price level's aggregate resting quantity after a change; zero means the level emptied
+struct LevelDelta {
+    int price;
+    bool direction;
+    uint64_t quantity;
+};
+
+struct PriceLevel {
+    int price;
+    uint64_t quantity;
+};
+
+// A book's touch, depths and best levels of each side, published after every command for
+// readers on other threads. Levels run best first; only the first bid_count/ask_count are set.
+struct BookTop {
+    static constexpr size_t MAX_LEVELS = 32; // Per side
+    uint64_t version; // Changes whenever the levels might have
+    uint64_t buy_depth;
+    uint64_t sell_depth;
+    int hi_bid;
+    int lo_ask;
+    uint32_t bid_count;
+    uint32_t ask_count;
+    PriceLevel bids[MAX_LEVELS];
+    PriceLevel asks[MAX_LEVELS];
+};
 
 class Orderbook {
 public:
-    Orderbook(int min_price, int max_price);
-    std::vector<Order> place_order(Order& order);
-    std::optional<Order> cancel_order(int order_id);
-    std::unordered_map<int, int> get_orders(bool direction, int price);
+    static constexpr size_t DEFAULT_DEPTH = 10;
+    Orderbook(int min_price, int max_price, Storage storage = DENSE, size_t depth = DEFAULT_DEPTH, int tick = 1);
+    ~Orderbook();
+    void place_order(Order& order, std::vector<Fill>& fills);
+    std::optional<Order> cancel_order(uint64_t order_id);
+    std::optional<Order> modify_order(uint64_t order_id, uint64_t quantity, Price price, std::vector<Fill>& fills);
+    size_t cancel_user(uint32_t user, std::vector<Order>& cancelled);
     uint64_t get_buy_depth();
     uint64_t get_sell_depth();
+    bool has_room(bool direction, uint64_t quantity);
+    bool can_resize(uint64_t order_id, uint64_t quantity);
     int get_min_price();
     int get_max_price();
+    Storage get_storage();
+    int get_tick();
+    int get_hi_bid();
+    int get_lo_ask();
+    uint64_t get_executions();
+    void set_executions(uint64_t executions);
+    void copy_levels(std::vector<ListNode>& nodes, std::vector<uint32_t>& heads);
+    void set_tracking(bool tracking);
+    void set_locations(OrderLocations* locations, uint32_t asset);
+    uint64_t take_deltas(std::vector<LevelDelta>& out);
+    uint64_t get_levels(std::vector<LevelDelta>& out);
+    size_t get_depth_limit();
+    void publish();
+    BookTop get_top();
+    uint64_t get_depth(size_t levels, std::vector<std::pair<int, uint64_t>>& bids, std::vector<std::pair<int, uint64_t>>& asks);
 
 private:
     uint64_t buy_depth; // Buy depth
     uint64_t sell_depth; // Sell depth
     int min_price; // Min price
     int max_price; // Max price
+    int tick; // Tick size; the book itself doesn't enforce it
     int lo_ask; // Lowest ask
     int hi_bid; // Highest bid
-    std::vector<Queue> book; // Array of queues for orders
-    std::unordered_map<int, int> prices; // Map of order IDs to prices
+    OrderPool pool; // Storage for every resting order in the book
+    Ladder book; // Queues for orders indexed by price
+    std::unique_ptr<OrderLocations> own_locations; // Used until the book is given a shared table
+    OrderLocations* locations; // Order ids to pool nodes
+    uint32_t asset; // This book's id in `locations`
+    std::vector<uint32_t> user_orders; // By user id, the node of their newest order resting here or NIL
+    uint64_t executions; // Last exec id handed out
+    bool tracking; // Whether changed levels are recorded for take_deltas
+    uint64_t sequence; // Bumped once per batch of deltas taken
+    std::vector<LevelDelta> touched; // Levels changed since the last take_deltas
+    size_t depth; // Levels per side kept in the depth view
+    bool bids_valid; // Whether the bid levels in `top` match the book
+    bool asks_valid; // Likewise for asks
+    bool changed; // Something moved since `top` was last published
+    BookTop top; // Matching thread's copy of what is published next
+    Seqlock<BookTop> published; // What readers see
+    struct BuySide;
+    struct SellSide;
+    template <typename Side>
+    void match(Order& order, std::vector<Fill>& fills);
+    void record_fill(std::vector<Fill>& fills, const Order& maker, const Order& taker, uint64_t quantity);
+    void touch(int price, bool direction);
+    bool in_depth(int price, bool direction);
+    void rebuild_bids();
+    void rebuild_asks();
     Queue& access_book(int price);
+    uint32_t rest_order(const Order& order);
+    Order unlink_order(uint32_t node);
+    void link_user(uint32_t node);
+    void unlink_user(uint32_t node);
+    void pop_front(Queue& level);
+    int prev_level(int price);
+    int next_level(int price);
+    void update_hi_bid();
+    void update_lo_ask();
 };
 
 #endif // ORDERBOOK_H
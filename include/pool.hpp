@@ -0,0 +1,37 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "order.hpp"
+#include "runtime.hpp"
+
+constexpr uint32_t NIL = UINT32_MAX; // Null node index
+
+struct ListNode {
+    Order order;
+    uint32_t next;
+    uint32_t prev;
+    uint32_t user_next; // The owner's other orders in the same book, newest first
+    uint32_t user_prev;
+};
+
+// Slab of order nodes addressed by index; freed nodes are recycled through a free list
+class OrderPool {
+public:
+    OrderPool(size_t capacity = 1024);
+    uint32_t allocate(const Order& order);
+    void release(uint32_t node);
+    ListNode& operator[](uint32_t node);
+    size_t get_size();
+    size_t get_capacity();
+    void copy_to(std::vector<ListNode>& out);
+
+private:
+    std::vector<ListNode, PageAllocator<ListNode>> nodes; // Backing slab, only grows; huge pages once it is big enough
+    uint32_t free_head; // Head of free list (threaded through `next`)
+    size_t size; // Live nodes
+};
+
+#endif // POOL_H
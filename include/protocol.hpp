@@ -0,0 +1,109 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include "order.hpp"
+
+// Binary order-entry protocol. Every message is a fixed-size little-endian struct that starts
+// with a header giving its total length and type, so a reader can frame it without parsing.
+// A session must log in as a registered user before entering orders; executions for that
+// user's orders are then pushed to the session as they happen.
+
+enum MessageType : uint8_t {
+    // Client to server
+    MSG_LOGIN = 'L',
+    MSG_ORDER = 'O',
+    MSG_CANCEL = 'X',
+    // Server to client
+    MSG_LOGGED_IN = 'l',
+    MSG_ACCEPTED = 'A',
+    MSG_REJECTED = 'J',
+    MSG_CANCELLED = 'C',
+    MSG_EXECUTED = 'E',
+};
+
+enum OrderType : uint8_t {
+    LIMIT,
+    MARKET,
+};
+
+enum RejectReason : uint8_t {
+    REJECT_NONE,
+    REJECT_UNKNOWN_USER,
+    REJECT_UNKNOWN_BOOK,
+    REJECT_PRICE,
+    REJECT_QUANTITY,
+    REJECT_NOT_LOGGED_IN,
+    REJECT_UNKNOWN_ORDER,
+    REJECT_BAD_MESSAGE,
+    REJECT_TICK, // Limit price isn't a multiple of the book's tick size
+    REJECT_ORDER_IDS, // Every order id the books can hold has been given out
+};
+
+constexpr int NAME_SIZE = 16; // User and asset names, NUL-padded
+
+#pragma pack(push, 1)
+
+struct MessageHeader {
+    uint16_t length; // Whole message including this header
+    uint8_t type;
+};
+
+struct LoginMessage {
+    MessageHeader header;
+    char user[NAME_SIZE];
+};
+
+struct OrderMessage {
+    MessageHeader header;
+    uint64_t client_ref; // Echoed back in the accept or reject
+    char asset[NAME_SIZE];
+    uint8_t direction; // BUY or SELL
+    uint8_t type; // LIMIT or MARKET
+    uint64_t quantity;
+    int32_t price; // Ignored for market orders
+};
+
+struct CancelMessage {
+    MessageHeader header;
+    uint64_t client_ref;
+    uint64_t order_id;
+};
+
+struct LoggedInMessage {
+    MessageHeader header;
+};
+
+struct AcceptedMessage {
+    MessageHeader header;
+    uint64_t client_ref;
+    uint64_t order_id;
+};
+
+struct RejectedMessage {
+    MessageHeader header;
+    uint64_t client_ref;
+    uint8_t reason; // RejectReason
+};
+
+struct CancelledMessage {
+    MessageHeader header;
+    uint64_t client_ref;
+    uint64_t order_id;
+    uint64_t quantity; // Quantity that was still resting
+};
+
+struct ExecutedMessage {
+    MessageHeader header;
+    uint64_t order_id;
+    uint64_t quantity;
+    int32_t price;
+    uint8_t direction;
+};
+
+#pragma pack(pop)
+
+// Largest message either side can send
+constexpr int MAX_MESSAGE_SIZE = sizeof(OrderMessage);
+
+#endif // PROTOCOL_H
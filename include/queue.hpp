@@ -1,34 +1,28 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
-#include <unordered_map>
+#include <cstdint>
 #include "order.hpp"
+#include "pool.hpp"
 
-struct ListNode {
-    Order order;
-    ListNode* next;
-    ListNode* prev;
-
-    ListNode(Order ord) : order(ord), next(nullptr), prev(nullptr) {}
-};
-
+// FIFO of orders at one price level; nodes live in the owning orderbook's pool
 class Queue {
 public:
     Queue();
-    ~Queue();
-    void enqueue(Order order);
-    void push(Order order);
-    Order remove(int order_id);
-    Order dequeue();
-    Order get_front();
+    uint32_t enqueue(OrderPool& pool, const Order& order);
+    uint32_t push(OrderPool& pool, const Order& order);
+    Order remove(OrderPool& pool, uint32_t node);
+    Order dequeue(OrderPool& pool);
+    Order& get_front(OrderPool& pool);
+    uint32_t get_head();
+    void reduce(OrderPool& pool, uint32_t node, uint64_t quantity);
     uint64_t get_quantity();
     bool isEmpty();
 
 private:
-    ListNode* head;
-    ListNode* tail;
+    uint32_t head;
+    uint32_t tail;
     uint64_t quantity;
-    std::unordered_map<int, ListNode*> orders;
 };
 
 #endif // QUEUE_H
@@ -0,0 +1,101 @@
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// Disruptor-style bounded ring for many producers and one consumer. Slots are allocated
+// once; producers claim a sequence with a single fetch_add, fill the slot in place and
+// publish it, and the consumer drains every contiguously published slot as one batch
+// before handing the whole batch back with a single store.
+template <typename T>
+class Ring {
+public:
+    Ring(size_t capacity);
+    size_t claim();
+    T& operator[](size_t seq);
+    void publish(size_t seq);
+    size_t available(size_t max_batch);
+    void release(size_t end);
+    bool isEmpty();
+    size_t get_pending();
+
+private:
+    std::unique_ptr<T[]> slots;
+    std::unique_ptr<std::atomic<size_t>[]> published; // Sequence last published into each slot
+    size_t size;
+    size_t mask; // Size - 1, size is a power of two
+    alignas(64) std::atomic<size_t> claimed; // Next sequence to hand to a producer
+    alignas(64) std::atomic<size_t> consumed; // Every sequence below this is free to reuse
+};
+
+template <typename T>
+Ring<T>::Ring(size_t capacity) : claimed(0), consumed(0) {
+    this->size = 1;
+    while (this->size < capacity) this->size <<= 1;
+    this->mask = this->size - 1;
+    this->slots.reset(new T[this->size]);
+    this->published.reset(new std::atomic<size_t>[this->size]);
+    for (size_t i = 0; i < this->size; i++) {
+        // One lap behind, so no slot looks published before its first write
+        this->published[i].store(i - this->size, std::memory_order_relaxed);
+    }
+}
+
+// Producer: reserves the next sequence, waiting for the consumer if the ring is full
+template <typename T>
+size_t Ring<T>::claim() {
+    size_t seq = this->claimed.fetch_add(1, std::memory_order_relaxed);
+    while (seq - this->consumed.load(std::memory_order_acquire) >= this->size) {
+        std::this_thread::yield();
+    }
+    return seq;
+}
+
+template <typename T>
+T& Ring<T>::operator[](size_t seq) {
+    return this->slots[seq & this->mask];
+}
+
+// Producer: makes a claimed slot visible to the consumer
+template <typename T>
+void Ring<T>::publish(size_t seq) {
+    this->published[seq & this->mask].store(seq, std::memory_order_release);
+}
+
+// Consumer: returns the end (exclusive) of the published run starting at the read cursor
+template <typename T>
+size_t Ring<T>::available(size_t max_batch) {
+    size_t start = this->consumed.load(std::memory_order_relaxed);
+    size_t end = start;
+    while (end - start < max_batch && this->published[end & this->mask].load(std::memory_order_acquire) == end) {
+        end++;
+    }
+    return end;
+}
+
+// Consumer: frees every slot before end for reuse
+template <typename T>
+void Ring<T>::release(size_t end) {
+    this->consumed.store(end, std::memory_order_release);
+}
+
+// Consumer only
+template <typename T>
+bool Ring<T>::isEmpty() {
+    size_t pos = this->consumed.load(std::memory_order_relaxed);
+    return this->published[pos & this->mask].load(std::memory_order_acquire) != pos;
+}
+
+// Any thread: slots claimed but not yet released, including ones still being filled
+template <typename T>
+size_t Ring<T>::get_pending() {
+    size_t consumed = this->consumed.load(std::memory_order_relaxed);
+    size_t claimed = this->claimed.load(std::memory_order_relaxed);
+    return claimed > consumed ? claimed - consumed : 0;
+}
+
+#endif // RING_H
@@ -0,0 +1,45 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+// Low-latency runtime mode: where threads run and what pages back the big per-book arrays
+
+std::vector<int> parse_cores(const std::string& list);
+bool pin_thread(const std::vector<int>& cores);
+
+constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+void set_huge_pages(bool enabled);
+bool probe_huge_pages();
+void* allocate_pages(size_t bytes);
+void free_pages(void* memory, size_t bytes);
+
+// Hands blocks of a huge page or more to allocate_pages, so containers using it land on huge
+// pages when they're enabled. Smaller blocks come from the heap as usual.
+template <typename T>
+struct PageAllocator {
+    using value_type = T;
+
+    PageAllocator() = default;
+    template <typename U>
+    PageAllocator(const PageAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(allocate_pages(count * sizeof(T)));
+    }
+
+    void deallocate(T* memory, size_t count) {
+        free_pages(memory, count * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PageAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const PageAllocator<U>&) const { return false; }
+};
+
+#endif // RUNTIME_H
@@ -0,0 +1,103 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <thread>
+#include <type_traits>
+
+// Single-writer seqlock. The writer bumps the sequence to odd, copies the value in and bumps it
+// back to even, so it never waits on readers. A reader copies the value out between two reads
+// of the sequence and retries if a write was in progress or landed in between, so it never sees
+// a torn value. The value is held as atomic words, which keeps the racing copies well defined.
+// Bytes [offset, offset + bytes) of a stored value
+struct SeqlockRange {
+    size_t offset;
+    size_t bytes;
+};
+
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock values are copied bytewise");
+
+public:
+    Seqlock();
+    void store(const T& value);
+    void store(const T& value, std::initializer_list<SeqlockRange> ranges);
+    T load() const;
+
+private:
+    static constexpr size_t WORDS = (sizeof(T) + 7) / 8;
+    alignas(64) std::atomic<uint64_t> seq; // Odd while a write is in progress
+    std::atomic<uint64_t> words[WORDS];
+    void copy_in(const unsigned char* data, size_t first, size_t last);
+};
+
+template <typename T>
+Seqlock<T>::Seqlock() : seq(0) {
+    for (auto& word : this->words) {
+        word.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Writer: publishes the whole value
+template <typename T>
+void Seqlock<T>::store(const T& value) {
+    this->store(value, {{0, sizeof(T)}});
+}
+
+// Writer: publishes only the given byte ranges of value, widened to whole words; the rest keeps
+// whatever was stored before, so a writer that knows what changed copies just that
+template <typename T>
+void Seqlock<T>::store(const T& value, std::initializer_list<SeqlockRange> ranges) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(&value);
+    uint64_t seq = this->seq.load(std::memory_order_relaxed);
+    this->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (const SeqlockRange& range : ranges) {
+        this->copy_in(data, range.offset / 8, std::min((range.offset + range.bytes + 7) / 8, WORDS));
+    }
+    this->seq.store(seq + 2, std::memory_order_release);
+}
+
+template <typename T>
+void Seqlock<T>::copy_in(const unsigned char* data, size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+        uint64_t word = 0;
+        if (i * 8 + 8 <= sizeof(T)) {
+            std::memcpy(&word, data + i * 8, 8); // Fixed size, so this compiles to a plain load
+        } else {
+            std::memcpy(&word, data + i * 8, sizeof(T) % 8);
+        }
+        this->words[i].store(word, std::memory_order_relaxed);
+    }
+}
+
+// Reader: any thread, any number at once
+template <typename T>
+T Seqlock<T>::load() const {
+    uint64_t copy[WORDS];
+    for (int spins = 0; ; spins++) {
+        uint64_t before = this->seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            if (spins > 64) std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < WORDS; i++) {
+            copy[i] = this->words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (this->seq.load(std::memory_order_relaxed) == before) {
+            break;
+        }
+    }
+    T value;
+    std::memcpy(&value, copy, sizeof(T));
+    return value;
+}
+
+#endif // SEQLOCK_H
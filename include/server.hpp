@@ -1,29 +1,92 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#include <atomic>
+#include <condition_variable>
 #include <crow.h>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <unordered_map>
 #include "engine.hpp"
+#include "feed.hpp"
+#include "gateway.hpp"
+#include "intern.hpp"
+#include "json.hpp"
+#include "journal.hpp"
+#include "notifier.hpp"
+#include "protocol.hpp"
 
 class Server {
 public:
-    Server(int port, Engine engine);
+    Server(int port, Engine& engine, int threads = 0, int binary_port = 0, int snapshot_interval = 0, int feed_refresh = 5, bool cancel_on_disconnect = false, bool busy_poll = false);
     void start_server();
+    std::optional<uint32_t> find_user(const std::string& user_id);
+    RejectReason accept_order(Order& order, bool market);
+    RejectReason match_order(Order& order, bool market, std::vector<Fill>& fills);
+    void report_fills(const std::vector<Fill>& fills);
+    uint64_t recover(Journal& journal);
+    uint64_t snapshot();
 
 private:
     int port;
+    int threads; // HTTP worker threads, 0 for Crow's default
+    int binary_port; // Port for the binary gateway, 0 to disable it
+    bool cancel_on_disconnect; // Whether the gateway pulls a user's orders when their last session drops
+    bool busy_poll; // Whether the gateway spins on its sockets instead of sleeping in epoll
+    int snapshot_interval; // Seconds between snapshots, 0 to only take them on request
+    int feed_refresh; // Seconds between full books on the market data feed, 0 for only on subscribe
     crow::SimpleApp app;
-    Engine engine;
+    Engine& engine;
     bool user_exists(const std::string& user_id);
-    std::unordered_map<std::string, std::string> users;
-    crow::response limit_order(Order order);
-    crow::response market_order(Order order);
-    crow::response cancel_order(int order_id);
+    std::shared_mutex users_lock; // Guards `users` and `callbacks` across HTTP threads
+    Interner users; // User names to ids
+    std::vector<std::string> callbacks; // Callback URLs indexed by user id
+    std::string get_user_name(uint32_t user);
+    void register_user(const std::string& user_id, const std::string& callback);
+    crow::response limit_order(const std::string& user, bool direction, const std::string& asset, int64_t quantity, int64_t price);
+    crow::response market_order(const std::string& user, bool direction, const std::string& asset, int64_t quantity);
+    crow::response enter_order(const std::string& user, bool direction, const std::string& asset, int64_t quantity, int64_t price, bool market);
+    crow::response cancel_order(uint64_t order_id);
+    crow::response modify_order(uint64_t order_id, int64_t quantity, int64_t price);
+    crow::response cancel_all(const std::string& user, const std::optional<std::string>& asset);
+    template <typename F>
+    void write_order(JsonWriter& json, const JsonShape& shape, const Order& order, Price price, uint64_t quantity, F extra);
+    crow::response run_batch(const std::string& body);
     crow::response update_user(const std::string& user_id, const std::string& callback);
-    crow::response get_orders(bool direction, const std::string& asset, int price);
+    crow::response get_orders(bool direction, const std::string& asset, int64_t price);
+    crow::response get_depth(const std::string& asset, int levels);
     crow::response add_orderbook(const Market& market);
-    int cur_order_idx = 0;
-    int inform_user(const Order& fill);
+    crow::response get_latency();
+    crow::response get_notifier();
+    crow::response get_metrics();
+    std::atomic<uint64_t> cur_order_idx = 0;
+    Journal* journal = nullptr; // Records user registrations, if set
+    std::mutex snapshot_lock; // One snapshot at a time
+    std::mutex snapshot_timer_lock; // Guards `stopping`
+    std::condition_variable snapshot_wake;
+    bool stopping = false;
+    std::thread snapshotter; // Takes periodic snapshots
+    void run_snapshots();
+    crow::response take_snapshot();
+    Notifier notifier; // Delivers fill callbacks off the request path
+    std::unique_ptr<Gateway> gateway; // Binary order entry, if enabled
+    struct CachedDepth {
+        uint64_t version; // Depth version the body was built from
+        std::string body;
+    };
+    std::mutex depth_lock; // Guards `depth_cache`
+    std::map<std::pair<uint32_t, int>, CachedDepth> depth_cache; // Serialised GET /depth replies by asset and level count, dropped with their book
+    void forget_depth(uint32_t asset);
+    std::unique_ptr<Feed> feed; // Market data, live while the server runs
+    std::mutex feed_lock; // Guards `feed` and `feed_clients`; held while sending to them
+    std::unordered_map<crow::websocket::connection*, std::unordered_map<uint32_t, bool>> feed_clients; // Assets each feed connection follows, and whether it has had their book yet
+    void subscribe(crow::websocket::connection& conn, const std::string& asset);
+    void unsubscribe_all(crow::websocket::connection& conn);
+    void send_deltas(const FeedBatch& batch);
+    void send_books(const std::vector<uint32_t>& assets);
+    void inform_user(const Fill& fill);
     crow::response shutdown();
 };
 
@@ -0,0 +1,50 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "histogram.hpp"
+#include "ring.hpp"
+
+// A unit of work handed to a shard; it lives on the submitter's stack until it is done
+struct Job {
+    void (*invoke)(void*);
+    void* context;
+    std::atomic<bool> done{false};
+    void wait();
+};
+
+// Pre-allocated ring slot
+struct Command {
+    Job* job;
+    uint64_t enqueued; // Steady clock ns when the command was published
+};
+
+// One matching thread and the command ring feeding it. Every orderbook belongs to exactly
+// one shard, so each book only ever has a single writer.
+class Shard {
+public:
+    Shard(int core, bool busy_poll = false);
+    ~Shard();
+    void submit(Job* job);
+    Histogram& get_latency();
+    size_t get_pending();
+
+private:
+    static constexpr size_t RING_SIZE = 4096;
+    static constexpr size_t MAX_BATCH = 256; // Commands drained before slots are handed back
+    static constexpr int IDLE_SPINS = 4096; // Empty polls before the thread goes to sleep
+    Ring<Command> ring;
+    Histogram latency; // Enqueue to match start, in ns
+    bool busy_poll; // Never park when idle; costs a whole core but skips the wakeup on the next command
+    std::atomic<bool> running;
+    std::atomic<bool> sleeping;
+    std::mutex lock; // Only used to park and wake an idle thread
+    std::condition_variable wake;
+    std::thread thread;
+    void run(int core);
+};
+
+#endif // SHARD_H
@@ -0,0 +1,94 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "order.hpp"
+#include "pool.hpp"
+
+// A snapshot file is a SnapshotHeader, then the users (name and callback lengths followed by
+// the bytes), then every interned asset name (length then bytes), padded to 8 bytes, then
+// each live book as a BookState followed by its resting orders.
+
+constexpr uint64_t SNAPSHOT_MAGIC = 0x3330504e534b424fULL; // "OBKSNP03"
+
+struct SnapshotHeader {
+    uint64_t magic;
+    uint64_t size; // Whole file, to catch truncation
+    uint64_t seq; // Every journal record at or below this is reflected
+    uint64_t users_seq; // User records at or below this are reflected
+    uint64_t directory_seq; // Book add/remove records at or below this are reflected
+    uint64_t next_order; // Order id counter
+    uint32_t users;
+    uint32_t assets; // Interned asset names, with or without a live book
+    uint32_t books;
+    uint32_t reserved;
+};
+
+// One book's state when it was captured
+struct BookState {
+    uint64_t seq; // Order records for this book at or below this are reflected
+    uint64_t buy_depth;
+    uint64_t sell_depth;
+    uint64_t orders; // Resting orders that follow
+    uint64_t executions; // Last exec id the book handed out
+    uint32_t asset;
+    uint32_t storage;
+    int32_t min;
+    int32_t max;
+    int32_t hi_bid;
+    int32_t lo_ask;
+    int32_t tick;
+    uint32_t reserved;
+};
+
+// A book copied out of the engine, waiting to be written. Copying the raw node slab keeps the
+// pause on the matching thread short; the levels are walked when the snapshot is written.
+struct BookImage {
+    BookState state;
+    std::vector<ListNode> nodes; // The book's pool as it was
+    std::vector<uint32_t> heads; // First node of each occupied level, lowest price first
+};
+
+// A book inside a loaded snapshot; `orders` points into the mapping
+struct BookView {
+    BookState state;
+    const Order* orders;
+};
+
+struct SnapshotImage {
+    SnapshotHeader header;
+    std::vector<std::pair<std::string, std::string>> users; // Name and callback, by user id
+    std::vector<std::string> assets; // By asset id
+    std::vector<BookImage> books;
+};
+
+void write_snapshot(const std::string& path, SnapshotImage& image);
+std::string snapshot_path(const std::string& directory, uint64_t seq);
+std::string find_snapshot(const std::string& directory);
+void remove_snapshots(const std::string& directory, const std::string& keep);
+
+// Read-only mapping of a snapshot file; the views stay valid while it is open
+class SnapshotFile {
+public:
+    SnapshotFile(const std::string& path);
+    ~SnapshotFile();
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator=(const SnapshotFile&) = delete;
+    const SnapshotHeader& get_header();
+    const std::vector<std::pair<std::string, std::string>>& get_users();
+    const std::vector<std::string>& get_assets();
+    const std::vector<BookView>& get_books();
+
+private:
+    void* mapping;
+    size_t size;
+    SnapshotHeader header;
+    std::vector<std::pair<std::string, std::string>> users;
+    std::vector<std::string> assets;
+    std::vector<BookView> books;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,74 @@
+#include "bitmap.hpp"
+
+Bitmap::Bitmap(size_t size) {
+    do {
+        size = (size + 63) / 64;
+        this->levels.emplace_back(size, 0);
+    } while (size > 1);
+}
+
+void Bitmap::set(size_t pos) {
+    for (auto& level : this->levels) {
+        uint64_t& word = level[pos / 64];
+        bool was_empty = word == 0;
+        word |= 1ULL << (pos % 64);
+        if (!was_empty) break; // Parents already mark this word
+        pos /= 64;
+    }
+}
+
+void Bitmap::clear(size_t pos) {
+    for (auto& level : this->levels) {
+        uint64_t& word = level[pos / 64];
+        word &= ~(1ULL << (pos % 64));
+        if (word != 0) break; // Word still occupied so parents stay set
+        pos /= 64;
+    }
+}
+
+bool Bitmap::test(size_t pos) {
+    return (this->levels[0][pos / 64] >> (pos % 64)) & 1;
+}
+
+// Returns the lowest set position >= pos, or -1 if there is none
+int64_t Bitmap::find_next(size_t pos) {
+    for (size_t l = 0; l < this->levels.size(); l++) {
+        size_t idx = pos / 64;
+        if (idx >= this->levels[l].size()) return -1;
+        uint64_t bits = this->levels[l][idx] & (~0ULL << (pos % 64));
+        if (bits) {
+            // Found a set bit on this level, walk back down taking the lowest child each time
+            pos = idx * 64 + __builtin_ctzll(bits);
+            for (size_t k = l; k > 0; k--) {
+                pos = pos * 64 + __builtin_ctzll(this->levels[k - 1][pos]);
+            }
+            return pos;
+        }
+        pos = idx + 1; // Nothing left in this word, resume after it one level up
+    }
+    return -1;
+}
+
+// Returns the highest set position <= pos, or -1 if there is none
+int64_t Bitmap::find_prev(size_t pos) {
+    for (size_t l = 0; l < this->levels.size(); l++) {
+        size_t idx = pos / 64;
+        if (idx >= this->levels[l].size()) {
+            // Clamp to the last word on this level
+            idx = this->levels[l].size() - 1;
+            pos = idx * 64 + 63;
+        }
+        uint64_t bits = this->levels[l][idx] & (~0ULL >> (63 - pos % 64));
+        if (bits) {
+            // Found a set bit on this level, walk back down taking the highest child each time
+            pos = idx * 64 + 63 - __builtin_clzll(bits);
+            for (size_t k = l; k > 0; k--) {
+                pos = pos * 64 + 63 - __builtin_clzll(this->levels[k - 1][pos]);
+            }
+            return pos;
+        }
+        if (idx == 0) return -1;
+        pos = idx - 1; // Nothing left in this word, resume before it one level up
+    }
+    return -1;
+}
@@ -1,68 +1,713 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
 #include "engine.hpp"
+#include "metrics.hpp"
+
+// Counts an aggressive order's fills and the levels it swept. A sweep takes each level's makers
+// together, so a new level starts wherever the fill price changes.
+static void record_fills(const Fill* fills, size_t count) {
+#ifdef ORDERBOOK_NO_METRICS
+    (void) fills;
+    (void) count;
+#else
+    if (count == 0) {
+        return;
+    }
+    uint64_t levels = 1;
+    for (size_t i = 1; i < count; i++) {
+        levels += fills[i].price != fills[i - 1].price;
+    }
+    METRIC_COUNT(METRIC_FILLS, count);
+    METRIC_RECORD(METRIC_SWEPT, levels);
+#endif
+}
 
 Engine::Engine() {}
 
-Engine::Engine(const std::vector<Market>& markets) : orderbooks() {
+// Shard i runs on cores[i], wrapping round if there are more shards than cores. Without a core
+// list shard i is pinned to core i where there are enough cores, otherwise the OS places it.
+Engine::Engine(const std::vector<Market>& markets, int shards, size_t depth, const std::vector<int>& cores, bool busy_poll) :
+    orderbooks(), depth(depth)
+{
+    int available = std::thread::hardware_concurrency();
+    for (int i = 0; i < shards; i++) {
+        int core = !cores.empty() ? cores[i % cores.size()] : i < available ? i : -1;
+        this->shards.push_back(std::make_unique<Shard>(core, busy_poll));
+    }
     for (const auto& market : markets) {
         this->add_orderbook(market);
     }
 }
 
 void Engine::add_orderbook(const Market& market) {
-    if (!this->orderbook_exists(market.name)) {
-        this->orderbooks.emplace(market.name, Orderbook(market.min, market.max));
+    std::unique_lock<std::shared_mutex> lock(this->directory_lock);
+    std::optional<uint32_t> existing = this->assets.find(market.name);
+    if (!existing || !this->orderbooks[*existing]) {
+        uint32_t asset = this->assets.intern(market.name);
+        if (asset >= this->orderbooks.size()) {
+            this->orderbooks.resize(asset + 1);
+        }
+        this->orderbooks[asset] = std::make_unique<Orderbook>(market.min, market.max, market.storage, this->depth, market.tick);
+        this->orderbooks[asset]->set_tracking(this->feed != nullptr);
+        this->orderbooks[asset]->set_locations(&this->locations, asset);
+        if (this->journal) {
+            std::string payload(sizeof(BookRecord), '\0');
+            BookRecord record{market.min, market.max, static_cast<uint32_t>(market.storage), market.tick};
+            std::memcpy(&payload[0], &record, sizeof(record));
+            payload += market.name;
+            this->journal->commit(this->journal->append(RECORD_BOOK, payload.data(), payload.size()));
+        }
     }
 }
 
 void Engine::remove_orderbook(const std::string& asset) {
-    this->orderbooks.erase(asset);
+    std::unique_lock<std::shared_mutex> lock(this->directory_lock);
+    std::optional<uint32_t> id = this->assets.find(asset);
+    if (!id || !this->orderbooks[*id]) {
+        return;
+    }
+    uint64_t seq = 0;
+    if (this->shards.empty()) {
+        this->orderbooks[*id].reset();
+        if (this->journal) {
+            seq = this->journal->append(RECORD_REMOVE, asset.data(), asset.size());
+        }
+        lock.unlock();
+        if (this->journal) {
+            this->journal->commit(seq);
+        }
+        if (this->on_remove) {
+            this->on_remove(*id);
+        }
+        return;
+    }
+
+    // Free the book on its own shard, behind any jobs already queued for it. It's journaled
+    // from there too, so the removal follows those jobs' records, and the lock is held until
+    // then so a re-add can't be journaled ahead of it.
+    std::unique_ptr<Orderbook> book = std::move(this->orderbooks[*id]);
+    auto task = [this, &book, &asset, &seq]() {
+        book.reset();
+        if (this->journal) {
+            seq = this->journal->append(RECORD_REMOVE, asset.data(), asset.size());
+        }
+    };
+    Job job{[](void* ctx) { (*static_cast<decltype(task)*>(ctx))(); }, &task};
+    this->shards[*id % this->shards.size()]->submit(&job);
+    job.wait();
+    lock.unlock();
+    if (this->journal) {
+        this->journal->commit(seq);
+    }
+    if (this->on_remove) {
+        this->on_remove(*id);
+    }
 }
 
 // Returns if an orderbook has been initialized already
 bool Engine::orderbook_exists(const std::string& asset) {
-    return this->orderbooks.find(asset) != this->orderbooks.end();
+    return this->get_asset_id(asset).has_value();
 }
 
-Orderbook& Engine::get_orderbook(const std::string& name) {
-    return this->orderbooks.at(name);
+// Resolves an asset name to the id used in orders, if it has a live orderbook
+std::optional<uint32_t> Engine::get_asset_id(const std::string& asset) {
+    std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+    std::optional<uint32_t> id = this->assets.find(asset);
+    if (!id || !this->orderbooks[*id]) {
+        return std::nullopt;
+    }
+    return id;
 }
 
-// Caller is responsible for checking if the orderbook exists
-std::vector<Order> Engine::place_order(Order& order) {
-    this->id_to_asset[order.order_id] = order.asset;
-    return this->get_orderbook(order.asset).place_order(order);
+std::string Engine::get_asset_name(uint32_t asset) {
+    std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+    return this->assets.get_name(asset);
+}
+
+// Callers must hold directory_lock
+Orderbook* Engine::get_orderbook(uint32_t asset) {
+    return asset < this->orderbooks.size() ? this->orderbooks[asset].get() : nullptr;
+}
+
+// Runs fn against asset's book on the shard that owns it (or inline) and waits for the result.
+// A missing book yields a default-constructed result.
+template <typename F>
+auto Engine::execute(uint32_t asset, F fn) -> decltype(fn(std::declval<Orderbook&>())) {
+    using Result = decltype(fn(std::declval<Orderbook&>()));
+    std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+    Orderbook* book = this->get_orderbook(asset);
+    if (!book) {
+        return Result{};
+    }
+    if (this->shards.empty()) {
+        std::lock_guard<std::mutex> guard(this->inline_lock);
+        return fn(*book);
+    }
+
+    // Submitting under the directory lock keeps a concurrent removal queued behind this job
+    std::optional<Result> result;
+    auto task = [&]() { result.emplace(fn(*book)); };
+    Job job{[](void* ctx) { (*static_cast<decltype(task)*>(ctx))(); }, &task};
+    this->shards[asset % this->shards.size()]->submit(&job);
+    lock.unlock();
+    job.wait();
+    return std::move(*result);
+}
+
+// Fills are appended to `fills` straight from the matching thread, so a caller reusing one
+// vector allocates nothing. Market orders are sized and priced here, on the thread holding the
+// book, so two takers can't both be sized against the same resting quantity. Returns
+// REJECT_UNKNOWN_BOOK if the book is gone, e.g. removed since the caller looked it up, and
+// REJECT_QUANTITY for a limit order that could take its side's depth past what it can count.
+RejectReason Engine::place_order(Order& order, std::vector<Fill>& fills, bool market) {
+    METRIC_TIMER(METRIC_PLACE);
+    size_t first = fills.size();
+    RejectReason reason = REJECT_UNKNOWN_BOOK; // Stays so if there's no book to run on
+    uint64_t seq = this->execute(order.asset, [this, &order, &fills, market, &reason](Orderbook& book) -> uint64_t {
+        reason = REJECT_NONE;
+        if (market) {
+            this->size_market(book, order); // Never rests, so needs no room
+        } else if (!book.has_room(order.direction, order.quantity)) {
+            reason = REJECT_QUANTITY;
+            return 0;
+        }
+        uint64_t seq = this->log_order(order);
+        book.place_order(order, fills);
+        this->publish_levels(book, order.asset);
+        return seq;
+    });
+    if (seq) {
+        this->journal->commit(seq);
+    }
+    record_fills(fills.data() + first, fills.size() - first);
+    return reason;
+}
+
+// Runs a batch in submission order. Placed orders must already have ids and checked prices.
+// Each run of consecutive entries on the same book goes to its shard as a single job. Every
+// entry's fills are appended to `fills`, and the entry records where its own start.
+void Engine::run_batch(std::vector<BatchEntry>& batch, std::vector<Fill>& fills) {
+    this->resolve_batch(batch);
+    uint64_t seq = 0;
+    size_t start = 0;
+    while (start < batch.size()) {
+        uint32_t asset = batch[start].order.asset;
+        size_t end = start + 1;
+        while (end < batch.size() && batch[end].order.asset == asset) {
+            end++;
+        }
+        for (size_t i = start; i < end; i++) {
+            if (batch[i].action != BATCH_CANCEL) {
+                batch[i].reason = REJECT_UNKNOWN_BOOK; // Until it runs, as its book may be gone
+            }
+        }
+        uint64_t last = this->execute(asset, [this, &batch, &fills, asset, start, end](Orderbook& book) {
+            uint64_t last = 0;
+            for (size_t i = start; i < end; i++) {
+                last = std::max(last, this->run_entry(book, batch[i], fills));
+            }
+            this->publish_levels(book, asset);
+            return last;
+        });
+        seq = std::max(seq, last);
+        start = end;
+    }
+    if (seq) {
+        this->journal->commit(seq);
+    }
+    for (const BatchEntry& entry : batch) {
+        if (entry.action == BATCH_CANCEL) {
+            METRIC_COUNT(entry.done ? METRIC_CANCELLED : METRIC_CANCEL_MISSES, 1);
+        } else {
+            record_fills(fills.data() + entry.first_fill, entry.fill_count);
+        }
+    }
+}
+
+// Finds the books a batch's cancels belong to: where the order rests now, or else the book of
+// an order placed earlier in the batch, which will have rested by the time the cancel runs
+void Engine::resolve_batch(std::vector<BatchEntry>& batch) {
+    for (size_t i = 0; i < batch.size(); i++) {
+        BatchEntry& entry = batch[i];
+        if (entry.action != BATCH_CANCEL) {
+            continue;
+        }
+        std::optional<Location> location = this->locations.find(entry.order.order_id);
+        entry.order.asset = location ? location->asset : UINT32_MAX; // No book, so it's skipped
+        for (size_t j = i; !location && j-- > 0; ) {
+            if (batch[j].action != BATCH_CANCEL && batch[j].order.order_id == entry.order.order_id) {
+                entry.order.asset = batch[j].order.asset;
+                break;
+            }
+        }
+    }
+}
+
+// Caps a market order at the depth it can reach and prices it at the far bound, so it sweeps
+// like a limit order without being left to rest
+void Engine::size_market(Orderbook& book, Order& order) {
+    if (order.direction == BUY) {
+        order.quantity = std::min(order.quantity, book.get_sell_depth());
+        order.price = book.get_max_price();
+    } else {
+        order.quantity = std::min(order.quantity, book.get_buy_depth());
+        order.price = book.get_min_price();
+    }
+}
+
+// Applies one batch entry and returns its journal seq, or 0 if nothing was journaled.
+// Market orders are sized against the book as it stands at this point.
+uint64_t Engine::run_entry(Orderbook& book, BatchEntry& entry, std::vector<Fill>& fills) {
+    if (entry.action == BATCH_CANCEL) {
+        std::optional<Order> cancelled = book.cancel_order(entry.order.order_id);
+        if (!cancelled) {
+            return 0;
+        }
+        entry.order = *cancelled;
+        entry.done = true;
+        return this->log_cancel(entry.order.order_id);
+    }
+    entry.reason = REJECT_NONE;
+    if (entry.action == BATCH_MARKET) {
+        this->size_market(book, entry.order);
+    } else if (!book.has_room(entry.order.direction, entry.order.quantity)) {
+        entry.reason = REJECT_QUANTITY;
+        return 0;
+    }
+    uint64_t seq = this->log_order(entry.order);
+    entry.first_fill = fills.size();
+    book.place_order(entry.order, fills);
+    entry.fill_count = fills.size() - entry.first_fill;
+    entry.done = true;
+    return seq;
+}
+
+// Caller is responsible for checking if the orderbook exists. Only the touch on the requested
+// side is ever reported (the bound is clamped to it), so the published top answers this.
+std::unordered_map<int, uint64_t> Engine::get_orders(bool direction, uint32_t asset, int price) {
+    BookTop top = this->get_top(asset);
+    std::unordered_map<int, uint64_t> ret;
+    if (direction == BUY && top.bid_count > 0 && price <= top.hi_bid) {
+        ret[top.hi_bid] = top.bids[0].quantity;
+    } else if (direction == SELL && top.ask_count > 0 && price >= top.lo_ask) {
+        ret[top.lo_ask] = top.asks[0].quantity;
+    }
+    return ret;
+}
+
+// Most levels per side a book's published top holds
+size_t Engine::get_depth_limit() {
+    return std::clamp<size_t>(this->depth, 1, BookTop::MAX_LEVELS);
+}
+
+// Reads asset's book as of its last command without going through its shard, so readers
+// neither wait behind matching nor hold it up. Zeroed if the book doesn't exist.
+BookTop Engine::get_top(uint32_t asset) {
+    std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+    Orderbook* book = this->get_orderbook(asset);
+    return book ? book->get_top() : BookTop{};
 }
 
 // Caller is responsible for checking if the orderbook exists
-std::unordered_map<int, int> Engine::get_orders(bool direction, const std::string& asset, int price) {
-    return this->get_orderbook(asset).get_orders(direction, price);
+uint64_t Engine::get_buy_depth(uint32_t asset) {
+    return this->get_top(asset).buy_depth;
 }
 
 // Caller is responsible for checking if the orderbook exists
-uint64_t Engine::get_buy_depth(const std::string& asset) {
-    return this->get_orderbook(asset).get_buy_depth();
+uint64_t Engine::get_sell_depth(uint32_t asset) {
+    return this->get_top(asset).sell_depth;
 }
 
 // Caller is responsible for checking if the orderbook exists
-uint64_t Engine::get_sell_depth(const std::string& asset) {
-    return this->get_orderbook(asset).get_sell_depth();
+int Engine::get_min_price(uint32_t asset) {
+    // Price bounds never change, so they're read directly rather than through the shard
+    std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+    return this->get_orderbook(asset)->get_min_price();
 }
 
 // Caller is responsible for checking if the orderbook exists
-int Engine::get_min_price(const std::string& asset) {
-    return this->get_orderbook(asset).get_min_price();
+int Engine::get_max_price(uint32_t asset) {
+    std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+    return this->get_orderbook(asset)->get_max_price();
 }
 
 // Caller is responsible for checking if the orderbook exists
-int Engine::get_max_price(const std::string& asset) {
-    return this->get_orderbook(asset).get_max_price();
+int Engine::get_tick(uint32_t asset) {
+    std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+    return this->get_orderbook(asset)->get_tick();
 }
 
 // Order does not have to exist
-std::optional<Order> Engine::cancel_order(int order_id) {
-    auto it = this->id_to_asset.find(order_id);
-    if (it == this->id_to_asset.end()) {
-        return std::nullopt; // order id not found
+std::optional<Order> Engine::cancel_order(uint64_t order_id) {
+    std::optional<Location> location = this->locations.find(order_id);
+    if (!location) {
+        METRIC_COUNT(METRIC_CANCEL_MISSES, 1);
+        return std::nullopt; // Not resting, or never was
+    }
+    uint32_t asset = location->asset;
+    uint64_t seq = 0;
+    std::optional<Order> cancelled = this->execute(asset, [this, asset, order_id, &seq](Orderbook& book) {
+        std::optional<Order> cancelled = book.cancel_order(order_id);
+        if (cancelled) {
+            seq = this->log_cancel(order_id);
+            this->publish_levels(book, asset);
+        }
+        return cancelled;
+    });
+    if (seq) {
+        this->journal->commit(seq);
+    }
+    METRIC_COUNT(cancelled ? METRIC_CANCELLED : METRIC_CANCEL_MISSES, 1);
+    return cancelled;
+}
+
+// Resizes or re-prices a resting order in a single pass through its book, appending any fills it
+// takes at a new price. Returns the order as it rested before, or nothing if it wasn't resting or
+// growing it would take its side's depth past what it can count, which sets `reason`.
+// Caller is responsible for checking the price against the order's book.
+std::optional<Order> Engine::modify_order(uint64_t order_id, uint64_t quantity, Price price, std::vector<Fill>& fills, RejectReason& reason) {
+    reason = REJECT_NONE;
+    std::optional<Location> location = this->locations.find(order_id);
+    if (!location) {
+        METRIC_COUNT(METRIC_MODIFY_MISSES, 1);
+        return std::nullopt;
+    }
+    uint32_t asset = location->asset;
+    size_t first = fills.size();
+    uint64_t seq = 0;
+    std::optional<Order> before = this->execute(asset, [this, asset, order_id, quantity, price, &fills, &seq, &reason](Orderbook& book) {
+        if (!book.can_resize(order_id, quantity)) {
+            reason = REJECT_QUANTITY;
+            return std::optional<Order>();
+        }
+        std::optional<Order> before = book.modify_order(order_id, quantity, price, fills);
+        if (before) {
+            seq = this->log_modify(order_id, quantity, price);
+            this->publish_levels(book, asset);
+        }
+        return before;
+    });
+    if (seq) {
+        this->journal->commit(seq);
+    }
+    METRIC_COUNT(before ? METRIC_MODIFIED : METRIC_MODIFY_MISSES, 1);
+    record_fills(fills.data() + first, fills.size() - first);
+    return before;
+}
+
+// Book an order rests in, if it still does
+std::optional<uint32_t> Engine::get_order_asset(uint64_t order_id) {
+    std::optional<Location> location = this->locations.find(order_id);
+    if (!location) {
+        return std::nullopt;
+    }
+    return location->asset;
+}
+
+// Cancels every order user has resting, only in asset's book if one is given, and appends them
+// to cancelled. Across all books each shard gets a single job for its share, and the shards run
+// theirs side by side.
+void Engine::cancel_user(uint32_t user, std::optional<uint32_t> asset, std::vector<Order>& cancelled) {
+    size_t first = cancelled.size();
+    uint64_t seq = 0;
+    if (asset) {
+        seq = this->execute(*asset, [this, &asset, user, &cancelled](Orderbook& book) {
+            return this->cancel_user_in(book, *asset, user, cancelled);
+        });
+    } else if (this->shards.empty()) {
+        std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+        std::lock_guard<std::mutex> guard(this->inline_lock);
+        for (uint32_t id = 0; id < this->orderbooks.size(); id++) {
+            if (this->orderbooks[id]) {
+                seq = std::max(seq, this->cancel_user_in(*this->orderbooks[id], id, user, cancelled));
+            }
+        }
+    } else {
+        // Each shard collects into its own list; they're joined in shard order afterwards
+        struct Part {
+            Engine* engine;
+            uint32_t user;
+            std::vector<std::pair<uint32_t, Orderbook*>> books;
+            std::vector<Order> cancelled;
+            uint64_t seq = 0;
+        };
+        std::vector<Part> parts(this->shards.size(), Part{this, user, {}, {}, 0});
+        std::deque<Job> jobs;
+        std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+        for (uint32_t id = 0; id < this->orderbooks.size(); id++) {
+            if (this->orderbooks[id]) {
+                parts[id % parts.size()].books.emplace_back(id, this->orderbooks[id].get());
+            }
+        }
+        for (size_t i = 0; i < parts.size(); i++) {
+            if (parts[i].books.empty()) {
+                continue;
+            }
+            Job& job = jobs.emplace_back();
+            job.invoke = [](void* ctx) {
+                Part& part = *static_cast<Part*>(ctx);
+                for (auto& [id, book] : part.books) {
+                    part.seq = std::max(part.seq, part.engine->cancel_user_in(*book, id, part.user, part.cancelled));
+                }
+            };
+            job.context = &parts[i];
+            this->shards[i]->submit(&job);
+        }
+        lock.unlock();
+        for (Job& job : jobs) {
+            job.wait();
+        }
+        for (Part& part : parts) {
+            cancelled.insert(cancelled.end(), part.cancelled.begin(), part.cancelled.end());
+            seq = std::max(seq, part.seq);
+        }
+    }
+    if (seq) {
+        this->journal->commit(seq);
+    }
+    METRIC_COUNT(METRIC_CANCELLED, cancelled.size() - first);
+}
+
+// Merges every shard's enqueue-to-match latency into latency
+void Engine::get_latency(Histogram& latency) {
+    for (auto& shard : this->shards) {
+        latency.merge(shard->get_latency());
+    }
+}
+
+// Commands waiting in each shard's ring, empty when matching inline
+void Engine::get_queue_depths(std::vector<size_t>& depths) {
+    for (auto& shard : this->shards) {
+        depths.push_back(shard->get_pending());
+    }
+}
+
+// Memory held by the order location table
+size_t Engine::get_location_bytes() {
+    return this->locations.get_bytes();
+}
+
+// Starts journaling changes to the books. Anything replayed from the journal must be restored
+// before this is set, or it would be journaled a second time.
+void Engine::set_journal(Journal* journal) {
+    this->journal = journal;
+}
+
+// Starts handing level changes to feed, or stops with nullptr. Like set_journal, only call
+// this while nothing else is using the engine.
+void Engine::set_feed(Feed* feed) {
+    std::unique_lock<std::shared_mutex> lock(this->directory_lock);
+    this->feed = feed;
+    for (auto& book : this->orderbooks) {
+        if (book) {
+            book->set_tracking(feed != nullptr);
+        }
+    }
+}
+
+// Has on_remove told the asset id of each book after it's removed, or stops with an empty
+// function. Like set_feed, only call this while nothing else is using the engine.
+void Engine::set_on_remove(std::function<void(uint32_t)> on_remove) {
+    std::unique_lock<std::shared_mutex> lock(this->directory_lock);
+    this->on_remove = std::move(on_remove);
+}
+
+// Fills levels with every occupied level of asset's book and returns the level sequence they
+// match. Caller is responsible for checking if the orderbook exists.
+uint64_t Engine::get_levels(uint32_t asset, std::vector<LevelDelta>& levels) {
+    return this->execute(asset, [&levels](Orderbook& book) { return book.get_levels(levels); });
+}
+
+// Applies a journaled record for the books directly on the calling thread, skipping the shards.
+// Only for replay at startup, before the engine is shared with anything else.
+void Engine::restore(const RecordHeader& header, const char* payload) {
+    if (header.type == RECORD_BOOK) {
+        BookRecord record;
+        std::memcpy(&record, payload, sizeof(record));
+        std::string name(payload + sizeof(record), header.length - sizeof(record));
+        this->add_orderbook(Market{name, record.min, record.max, static_cast<Storage>(record.storage), record.tick});
+    } else if (header.type == RECORD_REMOVE) {
+        this->remove_orderbook(std::string(payload, header.length));
+    } else if (header.type == RECORD_ORDER) {
+        Order order;
+        std::memcpy(&order, payload, sizeof(order));
+        std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+        if (order.asset < this->loaded_seq.size() && header.seq <= this->loaded_seq[order.asset]) {
+            return; // Already in the book as loaded from the snapshot
+        }
+        Orderbook* book = this->get_orderbook(order.asset);
+        if (book) {
+            thread_local std::vector<Fill> fills; // Already reported before the restart
+            fills.clear();
+            book->place_order(order, fills);
+            book->publish();
+        }
+    } else if (header.type == RECORD_CANCEL) {
+        uint64_t order_id;
+        std::memcpy(&order_id, payload, sizeof(order_id));
+        std::optional<Location> location = this->locations.find(order_id);
+        if (location) {
+            std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+            Orderbook* book = this->get_orderbook(location->asset);
+            if (book) {
+                book->cancel_order(order_id);
+                book->publish();
+            }
+        }
+    } else if (header.type == RECORD_MODIFY) {
+        ModifyRecord record;
+        std::memcpy(&record, payload, sizeof(record));
+        std::optional<Location> location = this->locations.find(record.order_id);
+        if (!location) {
+            return;
+        }
+        std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+        if (location->asset < this->loaded_seq.size() && header.seq <= this->loaded_seq[location->asset]) {
+            return; // Unlike a cancel, applying it twice would change the book
+        }
+        Orderbook* book = this->get_orderbook(location->asset);
+        if (book) {
+            thread_local std::vector<Fill> fills;
+            fills.clear();
+            book->modify_order(record.order_id, record.quantity, record.price, fills);
+            book->publish();
+        }
+    } else if (header.type == RECORD_CANCEL_USER) {
+        UserCancelRecord record;
+        std::memcpy(&record, payload, sizeof(record));
+        std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+        if (record.asset < this->loaded_seq.size() && header.seq <= this->loaded_seq[record.asset]) {
+            return; // Would take out orders the user placed after it
+        }
+        Orderbook* book = this->get_orderbook(record.asset);
+        if (book) {
+            thread_local std::vector<Order> cancelled;
+            cancelled.clear();
+            book->cancel_user(record.user, cancelled);
+            book->publish();
+        }
+    }
+}
+
+// Copies every book out for a snapshot. Each is copied on its own shard, so matching only
+// pauses for as long as that one book takes. Returns the journal seq that book adds and
+// removes are covered up to.
+uint64_t Engine::capture(std::vector<std::string>& assets, std::vector<BookImage>& books) {
+    // Held throughout so no book is added or removed part way through
+    std::shared_lock<std::shared_mutex> lock(this->directory_lock);
+    uint64_t seq = this->journal ? this->journal->get_last_seq() : 0;
+    for (uint32_t id = 0; id < this->assets.get_size(); id++) {
+        assets.push_back(this->assets.get_name(id));
+    }
+    for (uint32_t asset = 0; asset < this->orderbooks.size(); asset++) {
+        Orderbook* book = this->orderbooks[asset].get();
+        if (!book) {
+            continue;
+        }
+        books.emplace_back();
+        BookImage& image = books.back();
+        auto task = [this, book, asset, &image]() { this->copy_book(*book, asset, image); };
+        if (this->shards.empty()) {
+            std::lock_guard<std::mutex> guard(this->inline_lock);
+            task();
+            continue;
+        }
+        Job job{[](void* ctx) { (*static_cast<decltype(task)*>(ctx))(); }, &task};
+        this->shards[asset % this->shards.size()]->submit(&job);
+        job.wait();
+    }
+    return seq;
+}
+
+// Runs wherever the book is matched, so it can't change mid-copy and the seq read here splits
+// its journal records into those already reflected and those still to come
+void Engine::copy_book(Orderbook& book, uint32_t asset, BookImage& image) {
+    image.state.seq = this->journal ? this->journal->get_last_seq() : 0;
+    image.state.buy_depth = book.get_buy_depth();
+    image.state.sell_depth = book.get_sell_depth();
+    image.state.asset = asset;
+    image.state.storage = book.get_storage();
+    image.state.tick = book.get_tick();
+    image.state.min = book.get_min_price();
+    image.state.max = book.get_max_price();
+    image.state.hi_bid = book.get_hi_bid();
+    image.state.lo_ask = book.get_lo_ask();
+    image.state.executions = book.get_executions();
+    book.copy_levels(image.nodes, image.heads);
+}
+
+// Rebuilds assets and books from a snapshot, ahead of replaying the journal after it.
+// Must run on an empty engine before it's shared with anything else.
+void Engine::load(const std::vector<std::string>& assets, const std::vector<BookView>& books) {
+    std::unique_lock<std::shared_mutex> lock(this->directory_lock);
+    for (const std::string& name : assets) {
+        this->assets.intern(name);
+    }
+    this->orderbooks.resize(assets.size());
+    this->loaded_seq.assign(assets.size(), 0);
+    for (const BookView& view : books) {
+        const BookState& state = view.state;
+        auto book = std::make_unique<Orderbook>(state.min, state.max, static_cast<Storage>(state.storage), this->depth, state.tick);
+        book->set_locations(&this->locations, state.asset);
+        // Resting orders never cross, so placing them in order rebuilds every level's queue
+        std::vector<Fill> fills;
+        for (uint64_t i = 0; i < state.orders; i++) {
+            Order order = view.orders[i];
+            book->place_order(order, fills);
+        }
+        if (
+            book->get_buy_depth() != state.buy_depth || book->get_sell_depth() != state.sell_depth ||
+            book->get_hi_bid() != state.hi_bid || book->get_lo_ask() != state.lo_ask
+        ) {
+            throw std::runtime_error("snapshot: book " + assets[state.asset] + " doesn't match its recorded state");
+        }
+        book->set_executions(state.executions);
+        book->publish();
+        this->orderbooks[state.asset] = std::move(book);
+        this->loaded_seq[state.asset] = state.seq;
+    }
+}
+
+// All three are called from the job holding the book, so records land in the order the book saw them
+uint64_t Engine::log_order(const Order& order) {
+    return this->journal ? this->journal->append(RECORD_ORDER, &order, sizeof(order)) : 0;
+}
+
+uint64_t Engine::log_cancel(uint64_t order_id) {
+    return this->journal ? this->journal->append(RECORD_CANCEL, &order_id, sizeof(order_id)) : 0;
+}
+
+uint64_t Engine::log_modify(uint64_t order_id, uint64_t quantity, Price price) {
+    ModifyRecord record{order_id, quantity, price, 0};
+    return this->journal ? this->journal->append(RECORD_MODIFY, &record, sizeof(record)) : 0;
+}
+
+// Runs on the job holding the book: takes user's orders out of it, then journals and publishes
+// the book once for all of them
+uint64_t Engine::cancel_user_in(Orderbook& book, uint32_t asset, uint32_t user, std::vector<Order>& cancelled) {
+    if (book.cancel_user(user, cancelled) == 0) {
+        return 0;
+    }
+    uint64_t seq = 0;
+    if (this->journal) {
+        UserCancelRecord record{user, asset};
+        seq = this->journal->append(RECORD_CANCEL_USER, &record, sizeof(record));
+    }
+    this->publish_levels(book, asset);
+    return seq;
+}
+
+// Called from the job holding the book after each command (or run of batch entries): publishes
+// the book's top for readers, and its deltas so every book's reach the feed in sequence
+void Engine::publish_levels(Orderbook& book, uint32_t asset) {
+    book.publish();
+    if (!this->feed) {
+        return;
     }
-    return this->get_orderbook(it->second).cancel_order(order_id);
+    thread_local std::vector<LevelDelta> levels;
+    levels.clear();
+    uint64_t seq = book.take_deltas(levels);
+    this->feed->publish(asset, seq, levels);
 }
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <chrono>
+#include "feed.hpp"
+
+Feed::Feed(
+    std::function<void(const FeedBatch&)> deliver,
+    std::function<void(const std::vector<uint32_t>&)> refresh,
+    int refresh_interval,
+    size_t max_pending
+) :
+    deliver(std::move(deliver)),
+    refresh(std::move(refresh)),
+    refresh_interval(refresh_interval),
+    max_pending(max_pending),
+    subscribers(0),
+    dropped(0),
+    running(true)
+{
+    this->sender = std::thread(&Feed::run, this);
+}
+
+// Stops the sender; anything still buffered is discarded
+Feed::~Feed() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->running = false;
+    }
+    this->wake.notify_one();
+    this->sender.join();
+}
+
+// Buffers one command's level changes for a book. Called on the matching thread, so it only
+// copies; books nobody follows are skipped, and a full buffer drops the update, which the
+// consumer sees as a gap in seq until the next full book.
+void Feed::publish(uint32_t asset, uint64_t seq, const std::vector<LevelDelta>& levels) {
+    if (this->subscribers == 0 || levels.empty()) {
+        return;
+    }
+    bool full;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        auto it = this->counts.find(asset);
+        if (it == this->counts.end()) {
+            return;
+        }
+        if (this->pending.levels.size() >= this->max_pending) {
+            this->dropped++;
+            return;
+        }
+        uint32_t first = this->pending.levels.size();
+        this->pending.levels.insert(this->pending.levels.end(), levels.begin(), levels.end());
+        this->pending.updates.push_back({asset, seq, first, static_cast<uint32_t>(levels.size())});
+        full = first < FLUSH_LEVELS && this->pending.levels.size() >= FLUSH_LEVELS;
+    }
+    if (full) {
+        this->wake.notify_one();
+    }
+}
+
+// Follows an asset; a full book for it goes out on the sender's next pass
+void Feed::subscribe(uint32_t asset) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->counts[asset]++;
+    this->refreshing.push_back(asset);
+    this->subscribers++;
+}
+
+void Feed::unsubscribe(uint32_t asset) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    auto it = this->counts.find(asset);
+    if (it == this->counts.end()) {
+        return;
+    }
+    if (--it->second == 0) {
+        this->counts.erase(it);
+    }
+    this->subscribers--;
+}
+
+// Whether anyone is subscribed to anything
+bool Feed::is_active() {
+    return this->subscribers > 0;
+}
+
+// Updates refused because the buffer was full
+uint64_t Feed::get_dropped() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->dropped;
+}
+
+// Sender thread: every interval, or sooner once a lot has built up, delivers buffered deltas
+// and then any full books owed. Books are read after the deltas ahead of them went out, so a
+// consumer applying deltas with a higher seq than its last book stays in step.
+void Feed::run() {
+    using Clock = std::chrono::steady_clock;
+    FeedBatch sending;
+    std::vector<uint32_t> assets;
+    Clock::time_point next_refresh = Clock::now() + std::chrono::seconds(this->refresh_interval);
+    std::unique_lock<std::mutex> lock(this->lock);
+    while (true) {
+        this->wake.wait_for(lock, std::chrono::microseconds(FLUSH_INTERVAL_US), [this] {
+            return !this->running || this->pending.levels.size() >= FLUSH_LEVELS;
+        });
+        if (!this->running) {
+            break;
+        }
+        std::swap(sending, this->pending);
+        assets.swap(this->refreshing);
+        if (this->refresh_interval > 0 && Clock::now() >= next_refresh) {
+            for (const auto& [asset, count] : this->counts) {
+                assets.push_back(asset);
+            }
+            next_refresh = Clock::now() + std::chrono::seconds(this->refresh_interval);
+        }
+        lock.unlock();
+
+        if (!sending.updates.empty()) {
+            this->deliver(sending);
+        }
+        if (!assets.empty()) {
+            std::sort(assets.begin(), assets.end());
+            assets.erase(std::unique(assets.begin(), assets.end()), assets.end());
+            this->refresh(assets);
+        }
+        sending.updates.clear();
+        sending.levels.clear();
+        assets.clear();
+
+        lock.lock();
+    }
+}
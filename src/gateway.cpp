@@ -0,0 +1,281 @@
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "gateway.hpp"
+#include "server.hpp"
+
+// Expected size of each client message, 0 for types clients may not send
+static size_t message_size(uint8_t type) {
+    switch (type) {
+        case MSG_LOGIN: return sizeof(LoginMessage);
+        case MSG_ORDER: return sizeof(OrderMessage);
+        case MSG_CANCEL: return sizeof(CancelMessage);
+        default: return 0;
+    }
+}
+
+// Reads a NUL-padded fixed-width name
+static std::string read_name(const char* name) {
+    return std::string(name, strnlen(name, NAME_SIZE));
+}
+
+Gateway::Gateway(int port, Server& server, Engine& engine, bool cancel_on_disconnect, bool busy_poll) :
+    port(port),
+    server(server),
+    engine(engine),
+    cancel_on_disconnect(cancel_on_disconnect),
+    busy_poll(busy_poll),
+    running(true)
+{
+    this->listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int on = 1;
+    setsockopt(this->listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(this->listener, (sockaddr*) &addr, sizeof(addr)) < 0 || listen(this->listener, 128) < 0) {
+        close(this->listener);
+        throw std::runtime_error("could not listen on binary port " + std::to_string(port));
+    }
+
+    this->epoll = epoll_create1(0);
+    if (pipe(this->wakeup) < 0) {
+        throw std::runtime_error("could not create gateway wakeup pipe");
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = this->listener;
+    epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->listener, &event);
+    event.data.fd = this->wakeup[0];
+    epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->wakeup[0], &event);
+
+    this->thread = std::thread(&Gateway::run, this);
+}
+
+Gateway::~Gateway() {
+    this->stop();
+    for (auto& [fd, session] : this->sessions) {
+        close(fd);
+    }
+    close(this->listener);
+    close(this->epoll);
+    close(this->wakeup[0]);
+    close(this->wakeup[1]);
+}
+
+// Stops serving sessions and waits for the message in hand to finish
+void Gateway::stop() {
+    if (this->running.exchange(false)) {
+        char byte = 0;
+        (void) !write(this->wakeup[1], &byte, 1);
+        this->thread.join();
+    }
+}
+
+// Pushes an execution to every session logged in as either side of it; safe from any thread
+void Gateway::publish(const Fill& fill) {
+    ExecutedMessage maker{};
+    maker.header = MessageHeader{sizeof(ExecutedMessage), MSG_EXECUTED};
+    maker.order_id = fill.maker_order_id;
+    maker.quantity = fill.quantity;
+    maker.price = fill.price;
+    maker.direction = !fill.aggressor;
+    ExecutedMessage taker = maker;
+    taker.order_id = fill.taker_order_id;
+    taker.direction = fill.aggressor;
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    auto range = this->user_sessions.equal_range(fill.maker_user);
+    for (auto it = range.first; it != range.second; it++) {
+        this->send(it->second, &maker, sizeof(maker));
+    }
+    range = this->user_sessions.equal_range(fill.taker_user);
+    for (auto it = range.first; it != range.second; it++) {
+        this->send(it->second, &taker, sizeof(taker));
+    }
+}
+
+void Gateway::run() {
+    epoll_event events[64];
+    while (this->running.load()) {
+        int ready = epoll_wait(this->epoll, events, 64, this->busy_poll ? 0 : -1);
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            if (fd == this->wakeup[0]) {
+                return;
+            } else if (fd == this->listener) {
+                this->accept_session();
+            } else {
+                auto it = this->sessions.find(fd);
+                if (it != this->sessions.end() && !this->read_session(fd, it->second)) {
+                    this->close_session(fd);
+                }
+            }
+        }
+    }
+}
+
+void Gateway::accept_session() {
+    int fd;
+    while ((fd = accept4(this->listener, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        epoll_ctl(this->epoll, EPOLL_CTL_ADD, fd, &event);
+        this->sessions.emplace(fd, Session{});
+    }
+}
+
+// Drains the socket and handles every complete message; returns false to drop the session
+bool Gateway::read_session(int fd, Session& session) {
+    char chunk[4096];
+    while (true) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            session.buffer.insert(session.buffer.end(), chunk, chunk + n);
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return false; // Closed by peer or errored
+        }
+    }
+
+    size_t pos = 0;
+    while (session.buffer.size() - pos >= sizeof(MessageHeader)) {
+        MessageHeader header;
+        memcpy(&header, session.buffer.data() + pos, sizeof(header));
+        if (header.length != message_size(header.type)) {
+            return false; // Can't reframe after a bad length, so give up on the session
+        }
+        if (session.buffer.size() - pos < header.length) {
+            break;
+        }
+        if (!this->handle(fd, session, session.buffer.data() + pos, header.type, header.length)) {
+            return false;
+        }
+        pos += header.length;
+    }
+    session.buffer.erase(session.buffer.begin(), session.buffer.begin() + pos);
+    return true;
+}
+
+// Handles one framed message; returns false to drop the session
+bool Gateway::handle(int fd, Session& session, const char* data, uint8_t type, size_t length) {
+    if (type == MSG_LOGIN) {
+        LoginMessage message;
+        memcpy(&message, data, length);
+        std::optional<uint32_t> user = this->server.find_user(read_name(message.user));
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (!user) {
+            RejectedMessage reply{{sizeof(RejectedMessage), MSG_REJECTED}, 0, REJECT_UNKNOWN_USER};
+            this->send(fd, &reply, sizeof(reply));
+            return true;
+        }
+        if (!session.user) {
+            session.user = user;
+            this->user_sessions.emplace(*user, fd);
+        }
+        LoggedInMessage reply{{sizeof(LoggedInMessage), MSG_LOGGED_IN}};
+        this->send(fd, &reply, sizeof(reply));
+    } else if (type == MSG_ORDER) {
+        OrderMessage message;
+        memcpy(&message, data, length);
+        RejectReason reason = REJECT_NONE;
+        Order order{};
+        std::optional<uint32_t> asset = this->engine.get_asset_id(read_name(message.asset));
+        if (!session.user) {
+            reason = REJECT_NOT_LOGGED_IN;
+        } else if (!asset) {
+            reason = REJECT_UNKNOWN_BOOK;
+        } else if (message.direction > SELL || message.type > MARKET) {
+            reason = REJECT_BAD_MESSAGE;
+        } else {
+            order.quantity = message.quantity;
+            order.price = message.price;
+            order.user = *session.user;
+            order.asset = *asset;
+            order.direction = message.direction;
+            reason = this->server.accept_order(order, message.type == MARKET);
+        }
+        // Matched before answering, as the book can still refuse it; executions follow the accept
+        thread_local std::vector<Fill> fills;
+        fills.clear();
+        if (reason == REJECT_NONE) {
+            reason = this->server.match_order(order, message.type == MARKET, fills);
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            if (reason != REJECT_NONE) {
+                RejectedMessage reply{{sizeof(RejectedMessage), MSG_REJECTED}, message.client_ref, reason};
+                this->send(fd, &reply, sizeof(reply));
+                return true;
+            }
+            AcceptedMessage reply{{sizeof(AcceptedMessage), MSG_ACCEPTED}, message.client_ref, order.order_id};
+            this->send(fd, &reply, sizeof(reply));
+        }
+        this->server.report_fills(fills);
+    } else if (type == MSG_CANCEL) {
+        CancelMessage message;
+        memcpy(&message, data, length);
+        std::optional<Order> order;
+        if (session.user) {
+            order = this->engine.cancel_order(message.order_id);
+        }
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (!order) {
+            RejectReason reason = session.user ? REJECT_UNKNOWN_ORDER : REJECT_NOT_LOGGED_IN;
+            RejectedMessage reply{{sizeof(RejectedMessage), MSG_REJECTED}, message.client_ref, reason};
+            this->send(fd, &reply, sizeof(reply));
+        } else {
+            CancelledMessage reply{
+                {sizeof(CancelledMessage), MSG_CANCELLED}, message.client_ref, order->order_id, order->quantity
+            };
+            this->send(fd, &reply, sizeof(reply));
+        }
+    }
+    return true;
+}
+
+// Caller holds `lock`. A session that can't take a whole message right away is too slow to keep,
+// so it is shut down rather than allowed to stall the sender.
+void Gateway::send(int fd, const void* message, size_t length) {
+    ssize_t n = ::send(fd, message, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n != (ssize_t) length) {
+        shutdown(fd, SHUT_RDWR); // The gateway thread sees the hangup and closes it
+    }
+}
+
+// Drops a session, and with cancel_on_disconnect pulls its user's orders if it was their last
+void Gateway::close_session(int fd) {
+    Session& session = this->sessions[fd];
+    bool last = false;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (session.user) {
+            auto range = this->user_sessions.equal_range(*session.user);
+            for (auto it = range.first; it != range.second; it++) {
+                if (it->second == fd) {
+                    this->user_sessions.erase(it);
+                    break;
+                }
+            }
+            last = this->user_sessions.count(*session.user) == 0;
+        }
+        epoll_ctl(this->epoll, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+    }
+    if (this->cancel_on_disconnect && last) {
+        std::vector<Order> cancelled;
+        this->engine.cancel_user(*session.user, std::nullopt, cancelled);
+    }
+    this->sessions.erase(fd);
+}
@@ -0,0 +1,85 @@
+#include "histogram.hpp"
+
+Histogram::Histogram() : count(0), max(0), sum(0) {
+    for (auto& bucket : this->counts) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Single writer, so plain load/store pairs are enough
+void Histogram::record(uint64_t value) {
+    std::atomic<uint64_t>& bucket = this->counts[Histogram::bucket(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    this->count.store(this->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    this->sum.store(this->sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if (value > this->max.load(std::memory_order_relaxed)) {
+        this->max.store(value, std::memory_order_relaxed);
+    }
+}
+
+// Adds other's counts into this one; used to combine per-thread histograms for reporting
+void Histogram::merge(Histogram& other) {
+    for (int i = 0; i < BUCKETS; i++) {
+        this->counts[i].fetch_add(other.counts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    this->count.fetch_add(other.count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    this->sum.fetch_add(other.sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    uint64_t other_max = other.max.load(std::memory_order_relaxed);
+    if (other_max > this->max.load(std::memory_order_relaxed)) {
+        this->max.store(other_max, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Histogram::get_count() {
+    return this->count.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::get_max() {
+    return this->max.load(std::memory_order_relaxed);
+}
+
+// Total of every recorded value, for averages
+uint64_t Histogram::get_sum() {
+    return this->sum.load(std::memory_order_relaxed);
+}
+
+// Smallest recorded bucket value that at least p (0 to 1) of all values fall at or below
+uint64_t Histogram::percentile(double p) {
+    uint64_t total = 0;
+    for (auto& bucket : this->counts) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t target = p * total;
+    if (target < 1) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += this->counts[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return Histogram::bucket_value(i);
+        }
+    }
+    return this->get_max();
+}
+
+int Histogram::bucket(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    int magnitude = 63 - __builtin_clzll(value);
+    int sub = (value >> (magnitude - SUB_BITS)) & (SUB_BUCKETS - 1);
+    return (magnitude - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+// Midpoint of the values that land in bucket
+uint64_t Histogram::bucket_value(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int magnitude = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    int sub = bucket % SUB_BUCKETS;
+    uint64_t width = 1ULL << (magnitude - SUB_BITS);
+    return ((uint64_t) (SUB_BUCKETS + sub) << (magnitude - SUB_BITS)) + width / 2;
+}
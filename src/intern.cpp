@@ -0,0 +1,26 @@
+#include "intern.hpp"
+
+// Returns the id for name, assigning the next free one if it's new
+uint32_t Interner::intern(const std::string& name) {
+    auto [it, inserted] = this->ids.try_emplace(name, this->names.size());
+    if (inserted) {
+        this->names.push_back(name);
+    }
+    return it->second;
+}
+
+std::optional<uint32_t> Interner::find(const std::string& name) {
+    auto it = this->ids.find(name);
+    if (it == this->ids.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+const std::string& Interner::get_name(uint32_t id) {
+    return this->names[id];
+}
+
+size_t Interner::get_size() {
+    return this->names.size();
+}
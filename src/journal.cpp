@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "journal.hpp"
+
+// Records are padded so every header starts 8-byte aligned
+static size_t padded(size_t length) {
+    return (length + 7) & ~size_t(7);
+}
+
+// FNV-1a, continued from `hash`
+static uint32_t fnv(uint32_t hash, const void* data, size_t length) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t checksum(const RecordHeader& header, uint32_t payload_hash) {
+    uint32_t hash = fnv(payload_hash, &header.seq, sizeof(header.seq));
+    hash = fnv(hash, &header.length, sizeof(header.length));
+    return fnv(hash, &header.type, sizeof(header.type));
+}
+
+static std::string segment_name(uint64_t first_seq) {
+    std::string digits = std::to_string(first_seq);
+    return std::string(20 - digits.size(), '0') + digits + ".journal";
+}
+
+static void fail(const std::string& what) {
+    throw std::runtime_error("journal: " + what + ": " + std::strerror(errno));
+}
+
+// Opens the journal in `directory`, creating it if needed. A torn record left at the end of
+// the last segment by a crash is cut off so new records follow the last complete one.
+Journal::Journal(const std::string& directory, Durability durability) :
+    directory(directory), durability(durability), fd(-1), segment_size(0),
+    next_seq(1), durable(0), waiting(0), running(true)
+{
+    std::filesystem::create_directories(directory);
+    std::vector<std::string> segments = this->list_segments();
+    if (segments.empty()) {
+        this->open_segment(1);
+    } else {
+        const std::string& last = segments.back();
+        uint64_t first_seq = std::stoull(std::filesystem::path(last).filename().string());
+        uint64_t last_seq = first_seq - 1;
+        size_t good = this->scan_segment(last, 0, nullptr, last_seq);
+        if (good < std::filesystem::file_size(last)) {
+            std::cerr << "journal: dropping torn tail of " << last << " after seq " << last_seq << std::endl;
+            std::filesystem::resize_file(last, good);
+        }
+        this->next_seq = last_seq + 1;
+        this->durable = last_seq;
+        this->fd = ::open(last.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (this->fd < 0) {
+            fail("open " + last);
+        }
+        this->segment_size = good;
+    }
+    this->writer = std::thread(&Journal::run, this);
+}
+
+// Writes out and syncs whatever is still pending
+Journal::~Journal() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->running = false;
+    }
+    this->wake.notify_one();
+    this->writer.join();
+    if (this->durability == DURABLE_NONE) {
+        ::fdatasync(this->fd);
+    }
+    ::close(this->fd);
+}
+
+// Copies a record into the pending buffer and returns its sequence number. Safe to call from
+// any thread; records from one thread keep their relative order.
+uint64_t Journal::append(RecordType type, const void* payload, size_t length) {
+    if (length > UINT16_MAX) {
+        throw std::length_error("journal record too long");
+    }
+    uint32_t payload_hash = fnv(2166136261u, payload, length);
+    RecordHeader header{};
+    header.length = length;
+    header.type = type;
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    header.seq = this->next_seq++;
+    header.checksum = checksum(header, payload_hash);
+    size_t offset = this->pending.size();
+    this->pending.resize(offset + sizeof(header) + padded(length));
+    std::memcpy(&this->pending[offset], &header, sizeof(header));
+    std::memcpy(&this->pending[offset + sizeof(header)], payload, length);
+    if (offset < FLUSH_BYTES && this->pending.size() >= FLUSH_BYTES) {
+        this->wake.notify_one();
+    }
+    return header.seq;
+}
+
+// Returns once `seq` is as durable as the journal's mode promises
+void Journal::commit(uint64_t seq) {
+    if (this->durability != DURABLE_SYNC) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(this->lock);
+    if (this->durable >= seq) {
+        return;
+    }
+    this->waiting++;
+    this->wake.notify_one();
+    this->flushed.wait(lock, [this, seq] { return this->durable >= seq; });
+    this->waiting--;
+}
+
+// Hands every intact record with a sequence number above `after` to `apply`, oldest first.
+// Meant for startup, before anything is appended.
+void Journal::replay(uint64_t after, const std::function<void(const RecordHeader&, const char*)>& apply) {
+    std::vector<std::string> segments = this->list_segments();
+    for (size_t i = 0; i < segments.size(); i++) {
+        // A segment ends just before the next one starts, so fully replayed ones are skipped unread
+        if (i + 1 < segments.size()) {
+            uint64_t next_first = std::stoull(std::filesystem::path(segments[i + 1]).filename().string());
+            if (next_first <= after + 1) {
+                continue;
+            }
+        }
+        uint64_t last_seq = 0;
+        this->scan_segment(segments[i], after, &apply, last_seq);
+    }
+}
+
+// Deletes segments holding nothing after `seq`, once a snapshot covers them. The segment
+// being appended to is always kept.
+void Journal::discard(uint64_t seq) {
+    std::vector<std::string> segments = this->list_segments();
+    for (size_t i = 0; i + 1 < segments.size(); i++) {
+        uint64_t next_first = std::stoull(std::filesystem::path(segments[i + 1]).filename().string());
+        if (next_first > seq + 1) {
+            break;
+        }
+        std::filesystem::remove(segments[i]);
+    }
+}
+
+uint64_t Journal::get_last_seq() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->next_seq - 1;
+}
+
+Durability Journal::get_durability() {
+    return this->durability;
+}
+
+const std::string& Journal::get_directory() {
+    return this->directory;
+}
+
+// Segment paths in sequence order
+std::vector<std::string> Journal::list_segments() {
+    std::vector<std::string> segments;
+    for (const auto& entry : std::filesystem::directory_iterator(this->directory)) {
+        if (entry.path().extension() == ".journal") {
+            segments.push_back(entry.path().string());
+        }
+    }
+    std::sort(segments.begin(), segments.end()); // Names are zero-padded, so this is numeric order
+    return segments;
+}
+
+// Only called by the constructor and the writer thread
+void Journal::open_segment(uint64_t first_seq) {
+    if (this->fd >= 0) {
+        ::close(this->fd);
+    }
+    std::string path = this->directory + "/" + segment_name(first_seq);
+    this->fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (this->fd < 0) {
+        fail("open " + path);
+    }
+    this->segment_size = 0;
+
+    // The new file's directory entry has to be as durable as the records going into it
+    if (this->durability != DURABLE_NONE) {
+        int dir = ::open(this->directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir >= 0) {
+            ::fsync(dir);
+            ::close(dir);
+        }
+    }
+}
+
+// Walks a segment's records through a read-only mapping, stopping at the first one that is
+// cut short, fails its checksum or is out of sequence. Returns the bytes before that point.
+size_t Journal::scan_segment(const std::string& path, uint64_t after, const std::function<void(const RecordHeader&, const char*)>* apply, uint64_t& last_seq) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fail("open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        ::close(fd);
+        fail("stat " + path);
+    }
+    size_t size = st.st_size;
+    if (size == 0) {
+        ::close(fd);
+        return 0;
+    }
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        fail("mmap " + path);
+    }
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+    const char* data = static_cast<const char*>(mapping);
+
+    size_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= size) {
+        RecordHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        const char* payload = data + offset + sizeof(header);
+        size_t end = offset + sizeof(header) + padded(header.length);
+        if (
+            end > size ||
+            (last_seq != 0 && header.seq != last_seq + 1) ||
+            header.checksum != checksum(header, fnv(2166136261u, payload, header.length))
+        ) {
+            break;
+        }
+        last_seq = header.seq;
+        if (apply && header.seq > after) {
+            (*apply)(header, payload);
+        }
+        offset = end;
+    }
+    ::munmap(mapping, size);
+    return offset;
+}
+
+// Writer thread: drains the pending buffer every interval, or sooner when it fills up or a
+// committer is waiting, and rolls to a new segment once the current one is large enough
+void Journal::run() {
+    std::vector<char> writing;
+    std::unique_lock<std::mutex> lock(this->lock);
+    while (true) {
+        this->wake.wait_for(lock, std::chrono::microseconds(FLUSH_INTERVAL_US), [this] {
+            return !this->running || (!this->pending.empty() && (this->waiting > 0 || this->pending.size() >= FLUSH_BYTES));
+        });
+        if (this->pending.empty()) {
+            if (!this->running) {
+                break;
+            }
+            continue;
+        }
+        writing.swap(this->pending);
+        uint64_t last = this->next_seq - 1;
+        lock.unlock();
+
+        size_t written = 0;
+        while (written < writing.size()) {
+            ssize_t n = ::write(this->fd, writing.data() + written, writing.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                // Anything acknowledged from here on might not survive, so don't carry on
+                std::cerr << "journal: write failed: " << std::strerror(errno) << std::endl;
+                std::abort();
+            }
+            written += n;
+        }
+        if (this->durability != DURABLE_NONE && ::fdatasync(this->fd) < 0) {
+            std::cerr << "journal: fdatasync failed: " << std::strerror(errno) << std::endl;
+            std::abort();
+        }
+        this->segment_size += writing.size();
+        if (this->segment_size >= SEGMENT_BYTES) {
+            this->open_segment(last + 1);
+        }
+        writing.clear();
+
+        lock.lock();
+        this->durable = last;
+        this->flushed.notify_all();
+    }
+}
@@ -0,0 +1,200 @@
+#include <map>
+#include <unordered_map>
+#include "json.hpp"
+
+// "00" to "99", so numbers are written two digits per division
+struct DigitPairs {
+    char pairs[200];
+    constexpr DigitPairs() : pairs() {
+        for (int i = 0; i < 100; i++) {
+            this->pairs[2 * i] = static_cast<char>('0' + i / 10);
+            this->pairs[2 * i + 1] = static_cast<char>('0' + i % 10);
+        }
+    }
+};
+
+static constexpr DigitPairs DIGITS;
+
+JsonShape::JsonShape(std::initializer_list<const char*> keys) {
+    // Same key and hasher as wvalue's object map, so the same buckets and iteration order
+#ifdef CROW_JSON_USE_MAP
+    std::map<std::string, size_t> fields;
+#else
+    std::unordered_map<std::string, size_t> fields;
+#endif
+    for (const char* key : keys) {
+        std::string fragment;
+        JsonWriter json(fragment);
+        json.value(key);
+        fragment += ":";
+        fields.emplace(key, this->keys.size());
+        this->keys.push_back(fragment);
+    }
+    for (const auto& [key, field] : fields) {
+        this->order.push_back(field);
+    }
+}
+
+const size_t* JsonShape::begin() const {
+    return this->order.data();
+}
+
+const size_t* JsonShape::end() const {
+    return this->order.data() + this->order.size();
+}
+
+const std::string& JsonShape::key(size_t field) const {
+    return this->keys[field];
+}
+
+JsonWriter::JsonWriter(std::string& out) : out(out) {
+    this->first[0] = true;
+}
+
+void JsonWriter::begin_object() {
+    this->separate();
+    this->out += '{';
+    this->first[++this->nesting] = true;
+}
+
+void JsonWriter::end_object() {
+    this->out += '}';
+    this->nesting--;
+}
+
+void JsonWriter::begin_array() {
+    this->separate();
+    this->out += '[';
+    this->first[++this->nesting] = true;
+}
+
+void JsonWriter::end_array() {
+    this->out += ']';
+    this->nesting--;
+}
+
+void JsonWriter::key(const JsonShape& shape, size_t field) {
+    this->separate();
+    this->out += shape.key(field);
+    this->keyed = true;
+}
+
+// Object keys that are numbers, like the prices GET /orders reports
+void JsonWriter::key(int64_t name) {
+    this->separate();
+    this->out += '"';
+    this->append_number(name);
+    this->out += "\":";
+    this->keyed = true;
+}
+
+void JsonWriter::value(uint64_t number) {
+    this->separate();
+    this->append_number(number);
+}
+
+void JsonWriter::value(int64_t number) {
+    this->separate();
+    this->append_number(number);
+}
+
+void JsonWriter::value(uint32_t number) {
+    this->value(static_cast<uint64_t>(number));
+}
+
+void JsonWriter::value(int32_t number) {
+    this->value(static_cast<int64_t>(number));
+}
+
+void JsonWriter::value(const std::string& text) {
+    this->separate();
+    this->append_string(text.data(), text.size());
+}
+
+void JsonWriter::value(const char* text) {
+    this->separate();
+    this->append_string(text, std::char_traits<char>::length(text));
+}
+
+void JsonWriter::null() {
+    this->separate();
+    this->out += "null";
+}
+
+// Writes the comma before anything but the first item of an object or array
+void JsonWriter::separate() {
+    if (this->keyed) {
+        this->keyed = false;
+        return;
+    }
+    if (!this->first[this->nesting]) {
+        this->out += ',';
+    }
+    this->first[this->nesting] = false;
+}
+
+void JsonWriter::append_number(uint64_t number) {
+    char buffer[20];
+    char* end = buffer + sizeof(buffer);
+    char* digits = end;
+    while (number >= 100) {
+        const char* pair = &DIGITS.pairs[(number % 100) * 2];
+        number /= 100;
+        *--digits = pair[1];
+        *--digits = pair[0];
+    }
+    if (number >= 10) {
+        const char* pair = &DIGITS.pairs[number * 2];
+        *--digits = pair[1];
+        *--digits = pair[0];
+    } else {
+        *--digits = static_cast<char>('0' + number);
+    }
+    this->out.append(digits, end - digits);
+}
+
+void JsonWriter::append_number(int64_t number) {
+    if (number < 0) {
+        this->out += '-';
+        this->append_number(0 - static_cast<uint64_t>(number));
+    } else {
+        this->append_number(static_cast<uint64_t>(number));
+    }
+}
+
+// Quotes and escapes text the way crow::json::escape does, copying plain runs in one go
+void JsonWriter::append_string(const char* text, size_t size) {
+    static const char HEX[] = "0123456789abcdef";
+    this->out += '"';
+    size_t run = 0;
+    for (size_t i = 0; i < size; i++) {
+        char c = text[i];
+        const char* escaped;
+        switch (c) {
+            case '"': escaped = "\\\""; break;
+            case '\\': escaped = "\\\\"; break;
+            case '\n': escaped = "\\n"; break;
+            case '\b': escaped = "\\b"; break;
+            case '\f': escaped = "\\f"; break;
+            case '\r': escaped = "\\r"; break;
+            case '\t': escaped = "\\t"; break;
+            default:
+                if (c >= 0 && c < 0x20) {
+                    escaped = nullptr;
+                    break;
+                }
+                continue;
+        }
+        this->out.append(text + run, i - run);
+        run = i + 1;
+        if (escaped) {
+            this->out += escaped;
+        } else {
+            this->out += "\\u00";
+            this->out += HEX[c >> 4];
+            this->out += HEX[c & 0xf];
+        }
+    }
+    this->out.append(text + run, size - run);
+    this->out += '"';
+}
@@ -0,0 +1,78 @@
+#include "ladder.hpp"
+
+Ladder::Ladder(size_t size, Storage storage) :
+    storage(storage),
+    live_pages(0),
+    counts((size + PAGE_SIZE - 1) / PAGE_SIZE, 0),
+    occupied(size)
+{
+    if (storage == DENSE) {
+        this->levels.resize(size);
+        this->live_pages = this->counts.size();
+    } else {
+        this->pages.resize(this->counts.size());
+    }
+}
+
+// Returns the level at idx, materialising its page if needed
+Queue& Ladder::at(size_t idx) {
+    if (this->storage == DENSE) {
+        return this->levels[idx];
+    }
+    std::unique_ptr<Queue[]>& page = this->pages[idx >> PAGE_BITS];
+    if (!page) {
+        page.reset(this->new_page());
+    }
+    return page[idx & (PAGE_SIZE - 1)];
+}
+
+// Marks a level as non-empty
+void Ladder::occupy(size_t idx) {
+    this->occupied.set(idx);
+    this->counts[idx >> PAGE_BITS]++;
+}
+
+// Marks a level as empty, handing its page back once nothing rests in it
+void Ladder::vacate(size_t idx) {
+    this->occupied.clear(idx);
+    size_t page = idx >> PAGE_BITS;
+    if (--this->counts[page] == 0 && this->storage == PAGED) {
+        // Empty queues are all default state, so the page can be reused as is
+        if (this->spare.size() < MAX_SPARE) {
+            this->spare.push_back(std::move(this->pages[page]));
+        } else {
+            this->pages[page].reset();
+        }
+        this->live_pages--;
+    }
+}
+
+bool Ladder::is_occupied(size_t idx) {
+    return this->occupied.test(idx);
+}
+
+int64_t Ladder::find_next(size_t idx) {
+    return this->occupied.find_next(idx);
+}
+
+int64_t Ladder::find_prev(size_t idx) {
+    return this->occupied.find_prev(idx);
+}
+
+Storage Ladder::get_storage() {
+    return this->storage;
+}
+
+size_t Ladder::get_pages() {
+    return this->live_pages;
+}
+
+Queue* Ladder::new_page() {
+    this->live_pages++;
+    if (!this->spare.empty()) {
+        Queue* page = this->spare.back().release();
+        this->spare.pop_back();
+        return page;
+    }
+    return new Queue[PAGE_SIZE];
+}
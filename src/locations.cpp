@@ -0,0 +1,215 @@
+#include <cassert>
+#include "locations.hpp"
+
+OrderLocations::OrderLocations(bool concurrent) : concurrent(concurrent), last_page(0), pages(0) {}
+
+OrderLocations::~OrderLocations() {
+    for (auto& root : this->volumes) {
+        Volume* volume = root.load(std::memory_order_relaxed);
+        if (!volume) continue;
+        for (auto& slot : volume->directories) {
+            Directory* directory = slot.load(std::memory_order_relaxed);
+            if (!directory) continue;
+            for (auto& page : directory->pages) {
+                delete page.load(std::memory_order_relaxed);
+            }
+            delete directory;
+        }
+        delete volume;
+    }
+    for (Page* page : this->spare) {
+        delete page;
+    }
+}
+
+// Page holding ids index << PAGE_BITS onwards, or null. Takes no lock, so the page may be
+// recycled at any moment; shared tables never free a page, so it stays a page either way.
+OrderLocations::Page* OrderLocations::find_page(uint64_t index) {
+    Volume* volume = this->volumes[index >> (VOLUME_BITS + DIRECTORY_BITS)].load(std::memory_order_acquire);
+    if (!volume) {
+        return nullptr;
+    }
+    Directory* directory = volume->directories[(index >> DIRECTORY_BITS) & ((1 << VOLUME_BITS) - 1)].load(std::memory_order_acquire);
+    if (!directory) {
+        return nullptr;
+    }
+    return directory->pages[index & ((1 << DIRECTORY_BITS) - 1)].load(std::memory_order_acquire);
+}
+
+// Where index's page is published, adding the volume and directory on the way; caller holds the lock
+std::atomic<OrderLocations::Page*>& OrderLocations::add_slot(uint64_t index) {
+    std::atomic<Volume*>& root = this->volumes[index >> (VOLUME_BITS + DIRECTORY_BITS)];
+    Volume* volume = root.load(std::memory_order_relaxed);
+    if (!volume) {
+        volume = new Volume();
+        root.store(volume, std::memory_order_release);
+    }
+    std::atomic<Directory*>& slot = volume->directories[(index >> DIRECTORY_BITS) & ((1 << VOLUME_BITS) - 1)];
+    Directory* directory = slot.load(std::memory_order_relaxed);
+    if (!directory) {
+        directory = new Directory();
+        slot.store(directory, std::memory_order_release);
+    }
+    return directory->pages[index & ((1 << DIRECTORY_BITS) - 1)];
+}
+
+// Index's page with one more on its live count, so it can't be recycled until that's released.
+// Adds the page if there isn't one, e.g. for the first order in its range or one arriving after
+// the page was recycled.
+OrderLocations::Page* OrderLocations::pin_page(uint64_t index) {
+    Page* page = this->find_page(index);
+    if (page) {
+        uint32_t live = page->live.load(std::memory_order_relaxed);
+        while (!(live & DEAD) && !page->live.compare_exchange_weak(live, live + 1, std::memory_order_acquire, std::memory_order_relaxed)) {}
+        if (!(live & DEAD)) {
+            // It may have been recycled and reused for other ids since it was found
+            if ((page->stamp.load(std::memory_order_relaxed) & INDEX_MASK) == index) {
+                return page;
+            }
+            this->release_page(page);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(this->lock, std::defer_lock);
+    if (this->concurrent) {
+        lock.lock();
+    }
+    std::atomic<Page*>& slot = this->add_slot(index);
+    page = slot.load(std::memory_order_relaxed);
+    if (!page) {
+        if (this->spare.empty()) {
+            page = new Page();
+            for (auto& entry : page->entries) {
+                entry.store(EMPTY, std::memory_order_relaxed);
+            }
+            page->stamp.store(index, std::memory_order_relaxed);
+        } else {
+            // Spare pages are already empty, only their stamp needs to move on
+            page = this->spare.back();
+            this->spare.pop_back();
+            uint64_t generation = (page->stamp.load(std::memory_order_relaxed) & ~INDEX_MASK) + GENERATION;
+            page->stamp.store(generation | index, std::memory_order_relaxed);
+        }
+        page->live.store(0, std::memory_order_release); // Writers pinning it see the new stamp
+        slot.store(page, std::memory_order_release);
+        this->pages++;
+    }
+    page->live.fetch_add(1, std::memory_order_relaxed);
+    return page;
+}
+
+// Drops an entry or pin from page's live count, recycling it if that left it empty
+void OrderLocations::release_page(Page* page) {
+    if (page->live.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    // The page can only go once nothing will rest in it again, which dense ids promise as soon
+    // as a later page is in use
+    uint64_t index = page->stamp.load(std::memory_order_relaxed) & INDEX_MASK;
+    if (index < this->last_page.load(std::memory_order_relaxed)) {
+        this->recycle_page(page, index);
+    }
+}
+
+// Unpublishes page if it's still index's and nothing has pinned it since it emptied
+void OrderLocations::recycle_page(Page* page, uint64_t index) {
+    std::unique_lock<std::mutex> lock(this->lock, std::defer_lock);
+    if (this->concurrent) {
+        lock.lock();
+    }
+    std::atomic<Page*>& slot = this->add_slot(index);
+    uint32_t empty = 0;
+    if (slot.load(std::memory_order_relaxed) != page || !page->live.compare_exchange_strong(empty, DEAD, std::memory_order_acquire)) {
+        return;
+    }
+    slot.store(nullptr, std::memory_order_relaxed);
+    page->stamp.store(page->stamp.load(std::memory_order_relaxed) + GENERATION, std::memory_order_relaxed);
+    // Another thread may still be reading a shared table's page, so it's kept for reuse
+    if (this->concurrent || this->spare.size() < MAX_SPARE) {
+        this->spare.push_back(page);
+    } else {
+        delete page;
+    }
+    this->pages--;
+}
+
+void OrderLocations::set(uint64_t order_id, uint32_t asset, uint32_t node) {
+    assert(order_id <= MAX_ID); // Callers hand out no more ids than that
+    uint64_t index = order_id >> PAGE_BITS;
+    uint64_t entry = static_cast<uint64_t>(asset) << 32 | node;
+    uint64_t last = this->last_page.load(std::memory_order_relaxed);
+    while (index > last && !this->last_page.compare_exchange_weak(last, index, std::memory_order_relaxed)) {}
+
+    // Only the book an order rests in writes its entry, so nothing else races on the slot. An
+    // entry it already set keeps the page from being recycled, as in take; otherwise the pin
+    // becomes the entry's share of the live count.
+    Page* page = this->find_page(index);
+    size_t offset = order_id & ((1 << PAGE_BITS) - 1);
+    uint64_t current = page ? page->entries[offset].load(std::memory_order_relaxed) : EMPTY;
+    if (current == EMPTY || current >> 32 != asset) {
+        page = this->pin_page(index);
+    }
+    page->entries[offset].store(entry, std::memory_order_release);
+}
+
+// Forgets an order that has left its book, returning where it was, as long as it rested in asset.
+// Called from asset's matching thread. Only that thread writes entries for asset, so one found
+// here was set by it in this page's current use; an emptied page is never recycled with one left.
+std::optional<Location> OrderLocations::take(uint64_t order_id, uint32_t asset) {
+    Page* page = this->find_page(order_id >> PAGE_BITS);
+    if (!page) {
+        return std::nullopt;
+    }
+    std::atomic<uint64_t>& slot = page->entries[order_id & ((1 << PAGE_BITS) - 1)];
+    uint64_t entry = slot.load(std::memory_order_relaxed);
+    if (entry == EMPTY || entry >> 32 != asset) {
+        return std::nullopt;
+    }
+    slot.store(EMPTY, std::memory_order_relaxed);
+    this->release_page(page);
+    return Location{asset, static_cast<uint32_t>(entry)};
+}
+
+// Reads the page's stamp either side of the entry, seqlock style, so an entry from a page that
+// was recycled and reused meanwhile is never mistaken for this order's
+std::optional<Location> OrderLocations::find(uint64_t order_id) {
+    uint64_t index = order_id >> PAGE_BITS;
+    while (true) {
+        Page* page = this->find_page(index);
+        if (!page) {
+            return std::nullopt;
+        }
+        uint64_t stamp = page->stamp.load(std::memory_order_acquire);
+        uint64_t entry = page->entries[order_id & ((1 << PAGE_BITS) - 1)].load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((stamp & INDEX_MASK) != index || (stamp & GENERATION) || page->stamp.load(std::memory_order_relaxed) != stamp) {
+            continue; // Look the page up again
+        }
+        if (entry == EMPTY) {
+            return std::nullopt;
+        }
+        return Location{static_cast<uint32_t>(entry >> 32), static_cast<uint32_t>(entry)};
+    }
+}
+
+size_t OrderLocations::get_pages() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->pages;
+}
+
+// Memory held by the table, including volumes, directories and spare pages
+size_t OrderLocations::get_bytes() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    size_t volumes = 0;
+    size_t directories = 0;
+    for (auto& root : this->volumes) {
+        Volume* volume = root.load(std::memory_order_relaxed);
+        if (!volume) continue;
+        volumes++;
+        for (auto& slot : volume->directories) {
+            directories += slot.load(std::memory_order_relaxed) != nullptr;
+        }
+    }
+    return (this->pages + this->spare.size()) * sizeof(Page) + directories * sizeof(Directory) +
+        volumes * sizeof(Volume) + sizeof(this->volumes);
+}
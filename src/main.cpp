@@ -1,12 +1,29 @@
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
 #include "server.hpp"
 #include "engine.hpp"
+#include "runtime.hpp"
 
 int main(int argc, char* argv[]) {
     int port = 8080;
+    int shards = 0;
+    int threads = 0;
+    int binary_port = 0;
+    bool cancel_on_disconnect = false;
+    std::vector<int> cores;
+    std::vector<int> io_cores;
+    bool busy_poll = false;
+    bool huge_pages = false;
+    int snapshot_interval = 0;
+    int feed_refresh = 5;
+    int depth = Orderbook::DEFAULT_DEPTH;
+    std::string journal_dir;
+    Durability durability = DURABLE_BATCH;
     std::vector<Market> markets;
-    std::string usage = "Usage: " + std::string(argv[0]) + " [--port <port>] [--market <ticker> <min> <max>]...";
+    std::string usage = "Usage: " + std::string(argv[0]) + " [--port <port>] [--binary-port <port> [--cancel-on-disconnect]] [--shards <n>] [--threads <n>] [--cores <list>] [--io-cores <list>] [--busy-poll] [--huge-pages] [--feed-refresh <seconds>] [--depth <levels>] [--journal <dir> [--durability none|batch|sync] [--snapshot-interval <seconds>]] [--market <ticker> <min> <max> [dense|paged] [tick <size>]]...";
 
     for (int i = 1; i < argc; ++i) {
         if (std::string(argv[i]) == "--port") {
@@ -17,6 +34,96 @@ int main(int argc, char* argv[]) {
                 std::cerr << usage << std::endl;
                 return 1;
             }
+        } else if (std::string(argv[i]) == "--binary-port") {
+            if (i + 1 < argc) {
+                binary_port = std::stoi(argv[++i]);
+            } else {
+                std::cerr << "Error: No port specified after --binary-port" << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+        } else if (std::string(argv[i]) == "--cancel-on-disconnect") {
+            cancel_on_disconnect = true;
+        } else if (std::string(argv[i]) == "--cores" || std::string(argv[i]) == "--io-cores") {
+            std::string flag = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Error: No core list specified after " << flag << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+            std::vector<int> list;
+            try {
+                list = parse_cores(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Not a valid core list: " << argv[i] << std::endl;
+                return 1;
+            }
+            for (int core : list) {
+                if (core >= static_cast<int>(std::thread::hardware_concurrency())) {
+                    std::cerr << "Error: Core " << core << " does not exist" << std::endl;
+                    return 1;
+                }
+            }
+            (flag == "--cores" ? cores : io_cores) = list;
+        } else if (std::string(argv[i]) == "--busy-poll") {
+            busy_poll = true;
+        } else if (std::string(argv[i]) == "--huge-pages") {
+            huge_pages = true;
+        } else if (std::string(argv[i]) == "--journal") {
+            if (i + 1 < argc) {
+                journal_dir = argv[++i];
+            } else {
+                std::cerr << "Error: No directory specified after --journal" << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+        } else if (std::string(argv[i]) == "--durability") {
+            std::string mode = i + 1 < argc ? argv[++i] : "";
+            if (mode == "none") {
+                durability = DURABLE_NONE;
+            } else if (mode == "batch") {
+                durability = DURABLE_BATCH;
+            } else if (mode == "sync") {
+                durability = DURABLE_SYNC;
+            } else {
+                std::cerr << "Error: --durability must be one of none, batch or sync" << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+        } else if (std::string(argv[i]) == "--shards" || std::string(argv[i]) == "--threads" || std::string(argv[i]) == "--snapshot-interval" || std::string(argv[i]) == "--feed-refresh" || std::string(argv[i]) == "--depth") {
+            std::string flag = argv[i];
+            if (i + 1 < argc) {
+                int count;
+                try {
+                    count = std::stoi(argv[++i]);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: Not a valid integer: " << argv[i] << std::endl;
+                    return 1;
+                }
+                if (count < 0) {
+                    std::cerr << "Error: " << flag << " must not be negative" << std::endl;
+                    return 1;
+                }
+                if (flag == "--shards") {
+                    shards = count;
+                } else if (flag == "--snapshot-interval") {
+                    snapshot_interval = count;
+                } else if (flag == "--feed-refresh") {
+                    feed_refresh = count;
+                } else if (flag == "--depth") {
+                    if (count == 0 || count > static_cast<int>(BookTop::MAX_LEVELS)) {
+                        std::cerr << "Error: --depth must be between 1 and " << BookTop::MAX_LEVELS << std::endl;
+                        return 1;
+                    }
+                    depth = count;
+                } else {
+                    threads = count;
+                }
+            } else {
+                std::cerr << "Error: No count specified after " << flag << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
         } else if (std::string(argv[i]) == "--market") {
             if (i + 3 < argc) {
                 std::string name = argv[++i];
@@ -45,7 +152,28 @@ int main(int argc, char* argv[]) {
                     std::cerr << "Error: The min price for `" << name << "` must be less than the max" << std::endl;
                     return 1;
                 }
-                markets.push_back(Market{name, min, max});
+                Storage storage = DENSE;
+                if (i + 1 < argc && std::string(argv[i + 1]) == "dense") {
+                    i++;
+                } else if (i + 1 < argc && std::string(argv[i + 1]) == "paged") {
+                    storage = PAGED;
+                    i++;
+                }
+                int tick = 1;
+                if (i + 2 < argc && std::string(argv[i + 1]) == "tick") {
+                    try {
+                        tick = std::stoi(argv[i + 2]);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Error: Not a valid integer: " << argv[i + 2] << std::endl;
+                        return 1;
+                    }
+                    if (tick < 1 || tick > static_cast<int64_t>(max) - min) {
+                        std::cerr << "Error: The tick size for `" << name << "` must be between 1 and its price range" << std::endl;
+                        return 1;
+                    }
+                    i += 2;
+                }
+                markets.push_back(Market{name, min, max, storage, tick});
             } else {
                 std::cerr << "Error: No [ticker, min, max] specified after --market" << std::endl;
                 std::cerr << usage << std::endl;
@@ -59,15 +187,74 @@ int main(int argc, char* argv[]) {
     }
 
     std::cerr << "Starting server on port " << port << std::endl;
+    if (binary_port > 0) {
+        std::cerr << "Binary order entry on port " << binary_port << std::endl;
+        if (cancel_on_disconnect) {
+            std::cerr << "Cancelling a user's orders when their last binary session drops" << std::endl;
+        }
+    }
+    if (shards > 0) {
+        std::cerr << "Matching shards: " << shards << std::endl;
+    } else {
+        std::cerr << "Matching inline on HTTP threads" << std::endl;
+    }
+    if (!cores.empty() && shards > 0) {
+        std::cerr << "Matching cores:";
+        for (int core : cores) std::cerr << " " << core;
+        std::cerr << std::endl;
+    }
+    if (!io_cores.empty()) {
+        std::cerr << "I/O cores:";
+        for (int core : io_cores) std::cerr << " " << core;
+        std::cerr << std::endl;
+    }
+    if (busy_poll) {
+        std::cerr << "Busy polling: matching shards and the binary gateway spin instead of sleeping" << std::endl;
+    }
+    if (huge_pages) {
+        set_huge_pages(true);
+        if (probe_huge_pages()) {
+            std::cerr << "Huge pages: order pools and price ladders use reserved 2 MiB pages" << std::endl;
+        } else {
+            std::cerr << "Huge pages: none reserved (vm.nr_hugepages), asking for transparent huge pages instead" << std::endl;
+        }
+    }
     if (!markets.empty()) {
         std::cerr << "Markets:" << std::endl;
         for (const Market& market : markets) {
-            std::cerr << "  " << market.name << " [" << market.min << ", " << market.max << "]" << std::endl;
+            std::cerr << "  " << market.name << " [" << market.min << ", " << market.max << "]";
+            std::cerr << (market.storage == PAGED ? " paged" : "");
+            std::cerr << (market.tick > 1 ? " tick " + std::to_string(market.tick) : "") << std::endl;
+        }
+    }
+    if (!journal_dir.empty()) {
+        const char* modes[] = {"none", "batch", "sync"};
+        std::cerr << "Journal: " << journal_dir << " (durability " << modes[durability] << ")" << std::endl;
+        if (snapshot_interval > 0) {
+            std::cerr << "Snapshot every " << snapshot_interval << "s" << std::endl;
         }
     }
     std::cerr << std::endl;
 
-    Server server(port, Engine(markets));
+    // Markets are added after replay so journaled books keep the asset ids they were given
+    std::unique_ptr<Journal> journal;
+    Engine engine({}, shards, depth, cores, busy_poll);
+
+    // Everything started from here on, HTTP and gateway threads included, inherits this placement
+    if (!io_cores.empty() && !pin_thread(io_cores)) {
+        std::cerr << "Warning: Could not pin I/O threads, leaving them to the OS" << std::endl;
+    }
+    Server server(port, engine, threads, binary_port, snapshot_interval, feed_refresh, cancel_on_disconnect, busy_poll);
+    if (!journal_dir.empty()) {
+        journal = std::make_unique<Journal>(journal_dir, durability);
+        auto start = std::chrono::steady_clock::now();
+        uint64_t records = server.recover(*journal);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cerr << "Replayed " << records << " journal records in " << elapsed.count() << " ms" << std::endl;
+    }
+    for (const Market& market : markets) {
+        engine.add_orderbook(market);
+    }
     server.start_server();
     return 0;
 }
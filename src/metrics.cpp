@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "metrics.hpp"
+
+// Every thread's metrics, plus what threads that have exited left behind. Never freed, so a
+// thread exiting during static destruction still has somewhere to fold its numbers into.
+struct MetricsRegistry {
+    std::mutex lock;
+    std::vector<ThreadMetrics*> threads;
+    ThreadMetrics retired;
+};
+
+static MetricsRegistry& registry() {
+    static MetricsRegistry* registry = new MetricsRegistry();
+    return *registry;
+}
+
+static void add_into(ThreadMetrics& totals, ThreadMetrics& from) {
+    for (int i = 0; i < METRIC_COUNTERS; i++) {
+        totals.counters[i].fetch_add(from.counters[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    for (int i = 0; i < METRIC_SAMPLES; i++) {
+        totals.samples[i].merge(from.samples[i]);
+    }
+}
+
+// Registers the calling thread's metrics on first use and retires them when it exits
+struct LocalMetrics {
+    ThreadMetrics* metrics;
+
+    LocalMetrics() : metrics(new ThreadMetrics()) {
+        std::lock_guard<std::mutex> guard(registry().lock);
+        registry().threads.push_back(this->metrics);
+    }
+
+    ~LocalMetrics() {
+        MetricsRegistry& all = registry();
+        std::lock_guard<std::mutex> guard(all.lock);
+        add_into(all.retired, *this->metrics);
+        all.threads.erase(std::find(all.threads.begin(), all.threads.end(), this->metrics));
+        delete this->metrics;
+    }
+};
+
+ThreadMetrics& Metrics::local() {
+    thread_local LocalMetrics local;
+    return *local.metrics;
+}
+
+// Cheapest clock available: the TSC on x86, which on anything recent ticks at a constant rate
+// across cores, otherwise the steady clock in ns
+uint64_t Metrics::ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+#endif
+}
+
+// Measured once against the steady clock, the first time anything is reported
+double Metrics::ticks_per_ns() {
+    static double rate = [] {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t first = Metrics::ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t last = Metrics::ticks();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        return static_cast<double>(last - first) / elapsed.count();
+    }();
+    return rate;
+}
+
+// Adds up every thread's metrics, live and exited, into totals
+void Metrics::collect(ThreadMetrics& totals) {
+    MetricsRegistry& all = registry();
+    std::lock_guard<std::mutex> guard(all.lock);
+    add_into(totals, all.retired);
+    for (ThreadMetrics* metrics : all.threads) {
+        add_into(totals, *metrics);
+    }
+}
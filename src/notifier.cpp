@@ -0,0 +1,141 @@
+#include <chrono>
+#include <cpr/cpr.h>
+#include "notifier.hpp"
+
+Notifier::Notifier(int workers, size_t max_pending, int max_retries) :
+    max_pending(max_pending),
+    max_retries(max_retries),
+    running(true),
+    pending(0),
+    queued(0),
+    sent(0),
+    batches(0),
+    retries(0),
+    failed(0),
+    dropped(0)
+{
+    for (int i = 0; i < workers; i++) {
+        this->workers.emplace_back(&Notifier::run, this);
+    }
+}
+
+// Stops accepting work and waits for in-flight POSTs; fills still queued are discarded
+Notifier::~Notifier() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->running = false;
+    }
+    this->wake.notify_all();
+    for (auto& worker : this->workers) {
+        worker.join();
+    }
+}
+
+// Queues a serialised fill for user; never blocks on the network
+void Notifier::notify(uint32_t user, const std::string& url, std::string fill) {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (this->pending >= this->max_pending) {
+            this->dropped++;
+            return;
+        }
+        UserQueue& queue = this->queues[user];
+        queue.url = url;
+        queue.fills.push_back(std::move(fill));
+        this->pending++;
+        this->queued++;
+        if (queue.scheduled || queue.in_flight) {
+            return; // Will be picked up with the batch already on its way
+        }
+        queue.scheduled = true;
+        this->ready.push_back(user);
+    }
+    this->wake.notify_one();
+}
+
+NotifierStats Notifier::get_stats() {
+    NotifierStats stats;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        stats.pending = this->pending;
+    }
+    stats.queued = this->queued;
+    stats.sent = this->sent;
+    stats.batches = this->batches;
+    stats.retries = this->retries;
+    stats.failed = this->failed;
+    stats.dropped = this->dropped;
+    return stats;
+}
+
+void Notifier::run() {
+    cpr::Session session; // Kept for the worker's lifetime so connections are reused
+    std::unique_lock<std::mutex> guard(this->lock);
+    while (true) {
+        this->wake.wait(guard, [this]() { return !this->running || !this->ready.empty(); });
+        if (!this->running) {
+            return;
+        }
+
+        // Take everything queued for the next user
+        uint32_t user = this->ready.front();
+        this->ready.pop_front();
+        UserQueue& queue = this->queues[user];
+        std::vector<std::string> fills;
+        fills.swap(queue.fills);
+        std::string url = queue.url;
+        queue.scheduled = false;
+        queue.in_flight = true;
+        this->pending -= fills.size();
+        guard.unlock();
+
+        // A lone fill is sent as an object, several as an array
+        std::string body;
+        if (fills.size() == 1) {
+            body = std::move(fills[0]);
+        } else {
+            body = "[";
+            for (size_t i = 0; i < fills.size(); i++) {
+                if (i > 0) body += ",";
+                body += fills[i];
+            }
+            body += "]";
+        }
+        if (this->post(session, url, body)) {
+            this->sent += fills.size();
+            this->batches++;
+        } else {
+            this->failed += fills.size();
+        }
+
+        guard.lock();
+        UserQueue& after = this->queues[user];
+        after.in_flight = false;
+        if (!after.fills.empty() && !after.scheduled) {
+            // More fills arrived while we were posting
+            after.scheduled = true;
+            this->ready.push_back(user);
+            this->wake.notify_one();
+        }
+    }
+}
+
+// POSTs body, retrying with exponential backoff on connection errors and 5xx responses
+bool Notifier::post(cpr::Session& session, const std::string& url, const std::string& body) {
+    session.SetUrl(cpr::Url{url});
+    session.SetBody(cpr::Body{body});
+    session.SetHeader(cpr::Header{{"Content-Type", "application/json"}});
+    session.SetTimeout(cpr::Timeout{std::chrono::milliseconds(1000)});
+
+    for (int attempt = 0; ; attempt++) {
+        cpr::Response r = session.Post();
+        if (r.status_code > 0 && r.status_code < 500) {
+            return true;
+        }
+        if (attempt >= this->max_retries || !this->running) {
+            return false;
+        }
+        this->retries++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10 << attempt));
+    }
+}
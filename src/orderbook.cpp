@@ -1,15 +1,46 @@
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include "metrics.hpp"
 #include "orderbook.hpp"
 
-Orderbook::Orderbook(int min, int max) :
+// Shared by every book so a version never repeats, even across a book being removed and re-added
+static std::atomic<uint64_t> next_depth_version = 1;
+
+Orderbook::Orderbook(int min, int max, Storage storage, size_t depth, int tick) :
     buy_depth(0),
     sell_depth(0),
     min_price(min),
     max_price(max),
+    tick(tick),
     lo_ask(max+1),
     hi_bid(min-1),
-    book(max - min + 1)
-{}
+    book(max - min + 1, storage),
+    own_locations(std::make_unique<OrderLocations>(false)),
+    locations(own_locations.get()),
+    asset(0),
+    executions(0),
+    tracking(false),
+    sequence(0),
+    depth(std::clamp<size_t>(depth, 1, BookTop::MAX_LEVELS)),
+    bids_valid(false),
+    asks_valid(false),
+    changed(true),
+    top{}
+{
+    this->top.version = next_depth_version++;
+    this->publish();
+}
+
+// Forgets the orders still resting here when the table outlives the book
+Orderbook::~Orderbook() {
+    if (this->own_locations) {
+        return;
+    }
+    for (uint32_t node = 0; node < this->pool.get_capacity(); node++) {
+        this->locations->take(this->pool[node].order.order_id, this->asset);
+    }
+}
 
 int Orderbook::get_min_price() {
     return this->min_price;
@@ -19,30 +50,173 @@ int Orderbook::get_max_price() {
     return this->max_price;
 }
 
-std::optional<Order> Orderbook::cancel_order(int order_id) {
-    if (this->prices.find(order_id) == this->prices.end()) {
+Storage Orderbook::get_storage() {
+    return this->book.get_storage();
+}
+
+int Orderbook::get_tick() {
+    return this->tick;
+}
+
+int Orderbook::get_hi_bid() {
+    return this->hi_bid;
+}
+
+int Orderbook::get_lo_ask() {
+    return this->lo_ask;
+}
+
+uint64_t Orderbook::get_executions() {
+    return this->executions;
+}
+
+// Carries the exec id counter over when a book is rebuilt from a snapshot
+void Orderbook::set_executions(uint64_t executions) {
+    this->executions = executions;
+}
+
+// Copies the node slab and the head node of each occupied level, lowest price first. Following
+// `next` from a head gives that level's orders in time priority, and placing every order in
+// that sequence into an empty book rebuilds this one.
+void Orderbook::copy_levels(std::vector<ListNode>& nodes, std::vector<uint32_t>& heads) {
+    this->pool.copy_to(nodes);
+    for (int64_t idx = this->book.find_next(0); idx >= 0; idx = this->book.find_next(idx + 1)) {
+        heads.push_back(this->book.at(idx).get_head());
+    }
+}
+
+// Starts or stops recording which levels change. Only turn it on if take_deltas will be
+// called after every command, otherwise the list grows without bound.
+void Orderbook::set_tracking(bool tracking) {
+    this->tracking = tracking;
+    this->touched.clear();
+}
+
+// Records resting orders in `locations` under `asset` from now on, so one table can serve every
+// book in an engine. Only for a book with nothing resting yet.
+void Orderbook::set_locations(OrderLocations* locations, uint32_t asset) {
+    this->locations = locations;
+    this->asset = asset;
+    this->own_locations.reset();
+}
+
+// Appends the current quantity of every level changed since the last call and returns the
+// book's level sequence, which moves by one each time anything is appended
+uint64_t Orderbook::take_deltas(std::vector<LevelDelta>& out) {
+    if (this->touched.empty()) {
+        return this->sequence;
+    }
+    for (LevelDelta& delta : this->touched) {
+        // Test the bit rather than the queue so an emptied paged level isn't brought back. A level
+        // taken out and rested on by the other side reports 0 for the side it left.
+        size_t idx = delta.price - this->min_price;
+        bool held = this->book.is_occupied(idx) && (delta.price <= this->hi_bid ? BUY : SELL) == delta.direction;
+        delta.quantity = held ? this->book.at(idx).get_quantity() : 0;
+        out.push_back(delta);
+    }
+    this->touched.clear();
+    return ++this->sequence;
+}
+
+// Appends every occupied level, lowest price first, and returns the level sequence they match
+uint64_t Orderbook::get_levels(std::vector<LevelDelta>& out) {
+    for (int64_t idx = this->book.find_next(0); idx >= 0; idx = this->book.find_next(idx + 1)) {
+        int price = this->min_price + idx;
+        out.push_back({price, price <= this->hi_bid ? BUY : SELL, this->book.at(idx).get_quantity()});
+    }
+    return this->sequence;
+}
+
+size_t Orderbook::get_depth_limit() {
+    return this->depth;
+}
+
+// The book as of its last publish. Safe to call from any thread while it matches; never blocks,
+// and two reads with the same version saw the same levels.
+BookTop Orderbook::get_top() {
+    return this->published.load();
+}
+
+// Copies the best `levels` (at most the depth limit) price levels of each side, best first, and
+// returns the depth version they belong to. Reads the published top, so any thread may call it.
+uint64_t Orderbook::get_depth(size_t levels, std::vector<std::pair<int, uint64_t>>& bids, std::vector<std::pair<int, uint64_t>>& asks) {
+    BookTop top = this->get_top();
+    bids.clear();
+    asks.clear();
+    for (uint32_t i = 0; i < top.bid_count && i < levels; i++) {
+        bids.emplace_back(top.bids[i].price, top.bids[i].quantity);
+    }
+    for (uint32_t i = 0; i < top.ask_count && i < levels; i++) {
+        asks.emplace_back(top.asks[i].price, top.asks[i].quantity);
+    }
+    return top.version;
+}
+
+std::optional<Order> Orderbook::cancel_order(uint64_t order_id) {
+    METRIC_TIMER(METRIC_CANCEL);
+    std::optional<Location> location = this->locations->take(order_id, this->asset);
+    if (!location) {
         return std::nullopt;
     }
-    std::optional<Order> ret = this->access_book(this->prices[order_id]).remove(order_id);
+    return this->unlink_order(location->node);
+}
 
-    if (ret->direction == BUY) {
-        this->buy_depth -= ret->quantity;
-        if (this->buy_depth == 0) {
-            this->hi_bid = this->min_price - 1;
-        } else {
-            while (this->access_book(this->hi_bid).isEmpty()) this->hi_bid--;
-        }
-    } else {
-        this->sell_depth -= ret->quantity;
-        if (this->sell_depth == 0) {
-            this->lo_ask = this->max_price + 1;
-        } else {
-            while (this->access_book(this->lo_ask).isEmpty()) this->lo_ask++;
+// Resizes or re-prices a resting order and returns it as it rested before. Shrinking it at the
+// same price updates it in place, so it keeps its place in line; anything else takes it out and
+// places it again under the same id, matching first if the new price crosses. A quantity of 0
+// just cancels it.
+std::optional<Order> Orderbook::modify_order(uint64_t order_id, uint64_t quantity, Price price, std::vector<Fill>& fills) {
+    std::optional<Location> location = this->locations->find(order_id);
+    if (!location || location->asset != this->asset) {
+        return std::nullopt;
+    }
+    Order before = this->pool[location->node].order;
+    if (price == before.price && quantity > 0 && quantity <= before.quantity) {
+        uint64_t reduction = before.quantity - quantity;
+        if (reduction > 0) {
+            this->access_book(price).reduce(this->pool, location->node, reduction);
+            (before.direction == BUY ? this->buy_depth : this->sell_depth) -= reduction;
+            this->touch(price, before.direction);
         }
+        return before;
     }
 
-    this->prices.erase(order_id);
-    return ret;
+    this->locations->take(order_id, this->asset);
+    Order order = this->unlink_order(location->node);
+    order.quantity = quantity;
+    order.price = price;
+    this->place_order(order, fills);
+    return before;
+}
+
+// Cancels every order user has resting here, appending them to cancelled, and returns how many
+// there were. Walks only that user's list, and finds the new touch once at the end.
+size_t Orderbook::cancel_user(uint32_t user, std::vector<Order>& cancelled) {
+    if (user >= this->user_orders.size()) {
+        return 0;
+    }
+    size_t count = 0;
+    uint32_t node = this->user_orders[user];
+    while (node != NIL) {
+        uint32_t next = this->pool[node].user_next;
+        this->locations->take(this->pool[node].order.order_id, this->asset);
+        Queue& level = this->access_book(this->pool[node].order.price);
+        Order order = level.remove(this->pool, node);
+        this->touch(order.price, order.direction);
+        if (level.isEmpty()) {
+            this->book.vacate(order.price - this->min_price);
+        }
+        (order.direction == BUY ? this->buy_depth : this->sell_depth) -= order.quantity;
+        cancelled.push_back(order);
+        count++;
+        node = next;
+    }
+    this->user_orders[user] = NIL;
+    if (count > 0) {
+        this->update_hi_bid();
+        this->update_lo_ask();
+    }
+    return count;
 }
 
 uint64_t Orderbook::get_buy_depth() {
@@ -53,170 +227,286 @@ uint64_t Orderbook::get_sell_depth() {
     return this->sell_depth;
 }
 
-// Places order and returns orders that were matched
-std::vector<Order> Orderbook::place_order(Order& order) {
-    std::vector<Order> orders;
+// Whether `quantity` more resting on a side keeps its depth, and so every level on it, from wrapping
+bool Orderbook::has_room(bool direction, uint64_t quantity) {
+    return quantity <= UINT64_MAX - (direction == BUY ? this->buy_depth : this->sell_depth);
+}
+
+// Whether modifying a resting order to `quantity` keeps its side's depth from wrapping. An order
+// that isn't resting here is left for modify_order to miss.
+bool Orderbook::can_resize(uint64_t order_id, uint64_t quantity) {
+    if (this->has_room(BUY, quantity) && this->has_room(SELL, quantity)) {
+        return true; // It can't grow by more than quantity, so there's no need to find it
+    }
+    std::optional<Location> location = this->locations->find(order_id);
+    if (!location || location->asset != this->asset) {
+        return true;
+    }
+    const Order& order = this->pool[location->node].order;
+    return quantity <= order.quantity || this->has_room(order.direction, quantity - order.quantity);
+}
+
+// Side traits for match: where an incoming order of that side rests, and the opposite side it
+// takes liquidity from. Fixed at compile time, so each instantiation has no direction tests.
+struct Orderbook::BuySide {
+    static constexpr bool OPPOSITE = SELL;
+    static constexpr uint64_t Orderbook::* DEPTH = &Orderbook::buy_depth;
+    static constexpr int Orderbook::* TOUCH = &Orderbook::hi_bid;
+    static constexpr uint64_t Orderbook::* OPPOSITE_DEPTH = &Orderbook::sell_depth;
+    static constexpr int Orderbook::* OPPOSITE_TOUCH = &Orderbook::lo_ask;
+    static constexpr void (Orderbook::* NEXT_OPPOSITE)() = &Orderbook::update_lo_ask; // Steps up
+    static bool crosses(int price, int opposite) { return price >= opposite; }
+    static int better(int a, int b) { return std::max(a, b); }
+};
+
+struct Orderbook::SellSide {
+    static constexpr bool OPPOSITE = BUY;
+    static constexpr uint64_t Orderbook::* DEPTH = &Orderbook::sell_depth;
+    static constexpr int Orderbook::* TOUCH = &Orderbook::lo_ask;
+    static constexpr uint64_t Orderbook::* OPPOSITE_DEPTH = &Orderbook::buy_depth;
+    static constexpr int Orderbook::* OPPOSITE_TOUCH = &Orderbook::hi_bid;
+    static constexpr void (Orderbook::* NEXT_OPPOSITE)() = &Orderbook::update_hi_bid; // Steps down
+    static bool crosses(int price, int opposite) { return price <= opposite; }
+    static int better(int a, int b) { return std::min(a, b); }
+};
+
+// Places order, appending any fills to `fills`. Nothing is allocated once fills has capacity.
+void Orderbook::place_order(Order& order, std::vector<Fill>& fills) {
     if (order.quantity == 0) { // Edge case for market orders hitting empty book
-        return orders;
-    } else if (order.direction == BUY) {
-        while (order.price >= this->lo_ask) {
-            Order cur = this->access_book(this->lo_ask).dequeue(); // Matched order
-            if (order.quantity == cur.quantity) {
-                this->prices.erase(cur.order_id); // Delete cur from prices dict
-                order.price = cur.price; // Update price to cur
-
-                // Add to return dict of matched orders
-                orders.push_back(cur);
-                orders.push_back(order);
-
-                this->sell_depth -= cur.quantity; // Delete cur's depth from sell_depth
-
-                // Update lo_ask
-                if (this->sell_depth == 0) {
-                    this->lo_ask = this->max_price + 1;
-                } else {
-                    while (this->access_book(this->lo_ask).isEmpty()) this->lo_ask++;
-                }
-
-                return orders; // Break out since we're done
-            } else if (order.quantity < cur.quantity) {
-                // We fill at order's qty and cur's price
-                Order nxt = cur;
-                nxt.quantity = order.quantity;
-                order.price = cur.price;
-
-                // Add to return dict of matched orders
-                orders.push_back(nxt);
-                orders.push_back(order);
-
-                // Update sell_depth and cur's quantity
-                cur.quantity -= order.quantity;
-                this->sell_depth -= order.quantity;
-                this->access_book(cur.price).push(cur); // Toss back cur
-
-                return orders; // Break out since we're done
-            } else { // order.quantity > cur.quantity
-                Order part = order;
-                this->prices.erase(cur.order_id); // Delete cur from prices dict
-
-                // We fill at cur's qty and price
-                part.quantity = cur.quantity;
-                part.price = cur.price;
-
-                // Add to return dict of matched orders
-                orders.push_back(cur);
-                orders.push_back(part);
-
-                // We're now looking for fewer orders and sell_depth is lower
-                order.quantity -= cur.quantity;
-                this->sell_depth -= cur.quantity;
-
-                // Update lo_ask
-                if (this->sell_depth == 0) {
-                    this->lo_ask = this->max_price + 1;
-                } else {
-                    while (this->access_book(this->lo_ask).isEmpty()) this->lo_ask++;
-                }
-            }
-        }
-        // If we get here, we need to add the order to the book
-        this->access_book(order.price).enqueue(order);
-        this->prices[order.order_id] = order.price;
-        this->buy_depth += order.quantity;
-        this->hi_bid = std::max(order.price, this->hi_bid);
-        return orders;
+        return;
+    }
+    if (order.direction == BUY) {
+        this->match<BuySide>(order, fills);
     } else {
-        while (order.price <= this->hi_bid) {
-            Order cur = this->access_book(this->hi_bid).dequeue(); // Matched order
-            if (order.quantity == cur.quantity) {
-                this->prices.erase(cur.order_id); // Delete cur from prices dict
-                order.price = cur.price; // Update price to cur
-
-                // Add to return dict of matched orders
-                orders.emplace_back(cur);
-                orders.emplace_back(order);
-
-                this->buy_depth -= cur.quantity; // Delete cur's depth from buy_depth
-
-                // Update hi_bid
-                if (this->buy_depth == 0) {
-                    this->hi_bid = this->min_price - 1;
-                } else {
-                    while (this->access_book(this->hi_bid).isEmpty()) this->hi_bid--;
-                }
-
-                return orders; // Break out since we're done
-            } else if (order.quantity < cur.quantity) {
-                // We fill at order's qty and cur's price
-                Order nxt = cur;
-                nxt.quantity = order.quantity;
-                order.price = cur.price;
-
-                // Add to return dict of matched orders
-                orders.push_back(nxt);
-                orders.push_back(order);
-
-                // Update buy_depth and cur's quantity
-                cur.quantity -= order.quantity;
-                this->buy_depth -= order.quantity;
-                this->access_book(cur.price).push(cur); // Toss back cur
-
-                return orders; // Break out since we're done
-            } else { // order.quantity > cur.quantity
-                Order part = order;
-                this->prices.erase(cur.order_id); // Delete cur from prices dict
-
-                // We fill at cur's qty and price
-                part.quantity = cur.quantity;
-                part.price = cur.price;
-
-                // Add to return dict of matched orders
-                orders.push_back(cur);
-                orders.push_back(part);
-
-                // We're now looking for fewer orders and buy_depth is lower
-                order.quantity -= cur.quantity;
-                this->buy_depth -= cur.quantity;
-
-                // Update hi_bid
-                if (this->buy_depth == 0) {
-                    this->hi_bid = this->min_price - 1;
-                } else {
-                    while (this->access_book(this->hi_bid).isEmpty()) this->hi_bid--;
-                }
-            }
-        }
-        // If we get here, we need to add the order to the book
-        this->access_book(order.price).enqueue(order);
-        this->prices[order.order_id] = order.price;
-        this->sell_depth += order.quantity;
-        this->lo_ask = std::min(order.price, this->lo_ask);
-        return orders;
+        this->match<SellSide>(order, fills);
     }
 }
 
-std::unordered_map<int, int> Orderbook::get_orders(bool direction, int price) {
-    std::unordered_map<int, int> ret;
+void Orderbook::record_fill(std::vector<Fill>& fills, const Order& maker, const Order& taker, uint64_t quantity) {
+    fills.push_back(Fill{
+        ++this->executions,
+        maker.order_id,
+        taker.order_id,
+        quantity,
+        maker.price,
+        maker.user,
+        taker.user,
+        taker.asset,
+        taker.direction,
+    });
+}
 
-    if (direction == BUY) {
-        price = std::max(price, this->hi_bid);
-        for (int i = this->hi_bid; i >= price; i--) {
-            if (!this->access_book(i).isEmpty()) {
-                ret[i] = this->access_book(i).get_quantity();
-            }
-        }
-    } else {
-        price = std::min(price, this->lo_ask);
-        for (int i = this->lo_ask; i <= price; i++) {
-            if (!this->access_book(i).isEmpty()) {
-                ret[i] = this->access_book(i).get_quantity();
-            }
+// Matches order against the opposite side while it crosses, then rests whatever is left
+template <typename Side>
+void Orderbook::match(Order& order, std::vector<Fill>& fills) {
+    uint64_t& opposite_depth = this->*Side::OPPOSITE_DEPTH;
+    const int& opposite_touch = this->*Side::OPPOSITE_TOUCH;
+    while (Side::crosses(order.price, opposite_touch)) {
+        Queue& level = this->access_book(opposite_touch);
+        Order& cur = level.get_front(this->pool); // Matched order
+        if (order.quantity == cur.quantity) {
+            this->locations->take(cur.order_id, this->asset); // Forget where cur rested
+            order.price = cur.price; // Update price to cur
+            this->record_fill(fills, cur, order, cur.quantity);
+
+            opposite_depth -= cur.quantity; // Delete cur's depth from the opposite side
+            this->pop_front(level);
+
+            (this->*Side::NEXT_OPPOSITE)(); // Update the opposite touch
+
+            return; // Break out since we're done
+        } else if (order.quantity < cur.quantity) {
+            // We fill at order's qty and cur's price
+            order.price = cur.price;
+            this->record_fill(fills, cur, order, order.quantity);
+
+            // Update the opposite depth and shrink cur in place so it keeps its priority
+            opposite_depth -= order.quantity;
+            level.reduce(this->pool, level.get_head(), order.quantity);
+            this->touch(order.price, Side::OPPOSITE);
+
+            return; // Break out since we're done
+        } else { // order.quantity > cur.quantity
+            // We fill at cur's qty and price
+            this->locations->take(cur.order_id, this->asset); // Forget where cur rested
+            this->record_fill(fills, cur, order, cur.quantity);
+
+            // We're now looking for fewer orders and the opposite depth is lower
+            order.quantity -= cur.quantity;
+            opposite_depth -= cur.quantity;
+            this->pop_front(level);
+
+            (this->*Side::NEXT_OPPOSITE)(); // Update the opposite touch
         }
     }
+    // If we get here, we need to add the order to the book
+    this->locations->set(order.order_id, this->asset, this->rest_order(order));
+    this->*Side::DEPTH += order.quantity;
+    this->*Side::TOUCH = Side::better(order.price, this->*Side::TOUCH);
+}
 
+Queue& Orderbook::access_book(int price) {
+    return this->book.at(price - this->min_price);
+}
+
+// Adds order to the back of its level, marking the level occupied if it was empty
+uint32_t Orderbook::rest_order(const Order& order) {
+    this->touch(order.price, order.direction);
+    Queue& level = this->access_book(order.price);
+    if (level.isEmpty()) {
+        this->book.occupy(order.price - this->min_price);
+    }
+    uint32_t node = level.enqueue(this->pool, order);
+    this->link_user(node);
+    return node;
+}
+
+// Removes the front order of a level, clearing its occupancy bit if it empties
+void Orderbook::pop_front(Queue& level) {
+    this->unlink_user(level.get_head());
+    Order cur = level.dequeue(this->pool);
+    this->touch(cur.price, cur.direction);
+    if (level.isEmpty()) {
+        this->book.vacate(cur.price - this->min_price);
+    }
+}
+
+// Takes a resting order out of its level and the side's depth; its location is the caller's to clear
+Order Orderbook::unlink_order(uint32_t node) {
+    this->unlink_user(node);
+    Order ret = this->access_book(this->pool[node].order.price).remove(this->pool, node);
+    this->touch(ret.price, ret.direction);
+
+    if (this->access_book(ret.price).isEmpty()) {
+        this->book.vacate(ret.price - this->min_price);
+    }
+
+    if (ret.direction == BUY) {
+        this->buy_depth -= ret.quantity;
+        this->update_hi_bid();
+    } else {
+        this->sell_depth -= ret.quantity;
+        this->update_lo_ask();
+    }
     return ret;
 }
 
-Queue& Orderbook::access_book(int price) {
-    return this->book[price - this->min_price];
+// Puts a newly rested node at the front of its owner's list
+void Orderbook::link_user(uint32_t node) {
+    uint32_t user = this->pool[node].order.user;
+    if (user >= this->user_orders.size()) {
+        this->user_orders.resize(user + 1, NIL);
+    }
+    uint32_t head = this->user_orders[user];
+    this->pool[node].user_next = head;
+    if (head != NIL) {
+        this->pool[head].user_prev = node;
+    }
+    this->user_orders[user] = node;
+}
+
+void Orderbook::unlink_user(uint32_t node) {
+    ListNode& cur = this->pool[node];
+    if (cur.user_prev != NIL) {
+        this->pool[cur.user_prev].user_next = cur.user_next;
+    } else {
+        this->user_orders[cur.order.user] = cur.user_next;
+    }
+    if (cur.user_next != NIL) {
+        this->pool[cur.user_next].user_prev = cur.user_prev;
+    }
+}
+
+// Highest occupied level at or below price, or min_price - 1 if there is none
+int Orderbook::prev_level(int price) {
+    if (price < this->min_price) return this->min_price - 1;
+    int64_t idx = this->book.find_prev(price - this->min_price);
+    return idx < 0 ? this->min_price - 1 : this->min_price + idx;
+}
+
+// Lowest occupied level at or above price, or max_price + 1 if there is none
+int Orderbook::next_level(int price) {
+    if (price > this->max_price) return this->max_price + 1;
+    int64_t idx = this->book.find_next(price - this->min_price);
+    return idx < 0 ? this->max_price + 1 : this->min_price + idx;
+}
+
+// Bids and asks never share a level, so the next bid is the next occupied level down
+void Orderbook::update_hi_bid() {
+    this->hi_bid = this->buy_depth == 0 ? this->min_price - 1 : this->prev_level(this->hi_bid);
+}
+
+// Likewise the next ask is the next occupied level up
+void Orderbook::update_lo_ask() {
+    this->lo_ask = this->sell_depth == 0 ? this->max_price + 1 : this->next_level(this->lo_ask);
+}
+
+// Notes a changed level, marking the depth view stale if the level is in it or could join it.
+// Fills walking one level land on it repeatedly, so those collapse into one delta.
+void Orderbook::touch(int price, bool direction) {
+    this->changed = true;
+    bool& valid = direction == BUY ? this->bids_valid : this->asks_valid;
+    if (valid && this->in_depth(price, direction)) {
+        valid = false;
+        this->top.version = next_depth_version++;
+    }
+    if (!this->tracking || (
+        !this->touched.empty() && this->touched.back().price == price && this->touched.back().direction == direction
+    )) {
+        return;
+    }
+    this->touched.push_back({price, direction, 0});
+}
+
+// Whether a change at this level can alter the depth view of its side. Every level of the side
+// is in view while there are fewer than `depth`, and a new one would join it.
+bool Orderbook::in_depth(int price, bool direction) {
+    if (direction == BUY) {
+        return this->top.bid_count < this->depth || price >= this->top.bids[this->top.bid_count - 1].price;
+    }
+    return this->top.ask_count < this->depth || price <= this->top.asks[this->top.ask_count - 1].price;
+}
+
+// Walks the best levels out from the touch through the ladder's bitmap
+void Orderbook::rebuild_bids() {
+    uint32_t count = 0;
+    for (int i = this->hi_bid; i >= this->min_price && count < this->depth; i = this->prev_level(i - 1)) {
+        this->top.bids[count++] = PriceLevel{i, this->access_book(i).get_quantity()};
+    }
+    this->top.bid_count = count;
+    this->bids_valid = true;
+}
+
+void Orderbook::rebuild_asks() {
+    uint32_t count = 0;
+    for (int i = this->lo_ask; i <= this->max_price && count < this->depth; i = this->next_level(i + 1)) {
+        this->top.asks[count++] = PriceLevel{i, this->access_book(i).get_quantity()};
+    }
+    this->top.ask_count = count;
+    this->asks_valid = true;
+}
+
+// Publishes the book's state for get_top once a command, or a run of them, has finished with it.
+// Only a side whose levels a change reached is rebuilt and copied out; otherwise just the touch
+// and depths are. Matching itself never waits on readers.
+void Orderbook::publish() {
+    if (!this->changed) {
+        return;
+    }
+    this->changed = false;
+    SeqlockRange bids{0, 0};
+    SeqlockRange asks{0, 0};
+    if (!this->bids_valid) {
+        this->rebuild_bids();
+        bids = SeqlockRange{offsetof(BookTop, bids), this->top.bid_count * sizeof(PriceLevel)};
+    }
+    if (!this->asks_valid) {
+        this->rebuild_asks();
+        asks = SeqlockRange{offsetof(BookTop, asks), this->top.ask_count * sizeof(PriceLevel)};
+    }
+    this->top.buy_depth = this->buy_depth;
+    this->top.sell_depth = this->sell_depth;
+    this->top.hi_bid = this->hi_bid;
+    this->top.lo_ask = this->lo_ask;
+    this->published.store(this->top, {{0, offsetof(BookTop, bids)}, bids, asks});
 }
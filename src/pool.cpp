@@ -0,0 +1,45 @@
+#include "pool.hpp"
+
+OrderPool::OrderPool(size_t capacity) : free_head(NIL), size(0) {
+    this->nodes.reserve(capacity);
+}
+
+// Takes a node off the free list, growing the slab only when none are left
+uint32_t OrderPool::allocate(const Order& order) {
+    uint32_t node;
+    if (this->free_head != NIL) {
+        node = this->free_head;
+        this->free_head = this->nodes[node].next;
+        this->nodes[node] = ListNode{order, NIL, NIL, NIL, NIL};
+    } else {
+        node = this->nodes.size();
+        this->nodes.push_back(ListNode{order, NIL, NIL, NIL, NIL});
+    }
+    this->size++;
+    return node;
+}
+
+// Returns a node to the free list; caller must have unlinked it already
+void OrderPool::release(uint32_t node) {
+    this->nodes[node].next = this->free_head;
+    this->nodes[node].prev = NIL;
+    this->free_head = node;
+    this->size--;
+}
+
+ListNode& OrderPool::operator[](uint32_t node) {
+    return this->nodes[node];
+}
+
+size_t OrderPool::get_size() {
+    return this->size;
+}
+
+size_t OrderPool::get_capacity() {
+    return this->nodes.size();
+}
+
+// Copies the whole slab, free nodes included, which is cheaper than walking the live ones
+void OrderPool::copy_to(std::vector<ListNode>& out) {
+    out.assign(this->nodes.begin(), this->nodes.end());
+}
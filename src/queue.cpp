@@ -1,79 +1,83 @@
+#include <stdexcept>
 #include "queue.hpp"
 
-Queue::Queue() : head(nullptr), tail(nullptr), quantity(0) {}
+Queue::Queue() : head(NIL), tail(NIL), quantity(0) {}
 
-Queue::~Queue() {
-    while (!this->isEmpty()) {
-        this->dequeue();
-    }
-}
-
-void Queue::enqueue(Order order) {
-    ListNode* node = new ListNode{order};
-    this->orders[order.order_id] = node;
+// Appends order to the back of the queue and returns its node
+uint32_t Queue::enqueue(OrderPool& pool, const Order& order) {
+    uint32_t node = pool.allocate(order);
     if (this->isEmpty()) {
         this->head = node;
         this->tail = node;
     } else {
-        this->tail->next = node;
-        node->prev = this->tail;
+        pool[this->tail].next = node;
+        pool[node].prev = this->tail;
         this->tail = node;
     }
     this->quantity += order.quantity;
+    return node;
 }
 
-void Queue::push(Order order) {
-    ListNode* node = new ListNode{order};
-    this->orders[order.order_id] = node;
+// Inserts order at the front of the queue and returns its node
+uint32_t Queue::push(OrderPool& pool, const Order& order) {
+    uint32_t node = pool.allocate(order);
     if (this->isEmpty()) {
         this->head = node;
         this->tail = node;
     } else {
-        this->head->prev = node;
-        node->next = this->head;
+        pool[this->head].prev = node;
+        pool[node].next = this->head;
         this->head = node;
     }
     this->quantity += order.quantity;
+    return node;
 }
 
-Order Queue::remove(int order_id) {
-    if (this->orders.find(order_id) == this->orders.end()) {
-        throw std::out_of_range("Order not found");
-    }
-    ListNode* node = this->orders[order_id];
-    Order ret = node->order;
+// Unlinks node from the queue and hands it back to the pool
+Order Queue::remove(OrderPool& pool, uint32_t node) {
+    ListNode& cur = pool[node];
+    Order ret = cur.order;
 
     if (node == this->head && node == this->tail) {  // only one node
-        this->head = this->tail = nullptr;
+        this->head = this->tail = NIL;
     } else if (node == this->head) {  // removing head
-        this->head = this->head->next;
-        this->head->prev = nullptr;
+        this->head = cur.next;
+        pool[this->head].prev = NIL;
     } else if (node == this->tail) {  // removing tail
-        this->tail = this->tail->prev;
-        this->tail->next = nullptr;
+        this->tail = cur.prev;
+        pool[this->tail].next = NIL;
     } else {  // removing a middle node
-        node->prev->next = node->next;
-        node->next->prev = node->prev;
+        pool[cur.prev].next = cur.next;
+        pool[cur.next].prev = cur.prev;
     }
 
     this->quantity -= ret.quantity;
-    this->orders.erase(order_id);
-    delete node;
+    pool.release(node);
     return ret;
 }
 
-Order Queue::dequeue() {
+Order Queue::dequeue(OrderPool& pool) {
     if (this->isEmpty()) {
         throw std::out_of_range("Queue is empty");
     }
-    return this->remove(this->head->order.order_id);
+    return this->remove(pool, this->head);
 }
 
-Order Queue::get_front() {
+Order& Queue::get_front(OrderPool& pool) {
     if (this->isEmpty()) {
         throw std::out_of_range("Queue is empty");
     }
-    return this->head->order;
+    return pool[this->head].order;
+}
+
+uint32_t Queue::get_head() {
+    return this->head;
+}
+
+// Shrinks a resting order in place without losing its place in line
+void Queue::reduce(OrderPool& pool, uint32_t node, uint64_t quantity) {
+    pool[node].order.quantity -= quantity;
+    this->quantity -= quantity;
 }
 
 uint64_t Queue::get_quantity() {
@@ -81,5 +85,5 @@ uint64_t Queue::get_quantity() {
 }
 
 bool Queue::isEmpty() {
-    return this->head == nullptr;
+    return this->head == NIL;
 }
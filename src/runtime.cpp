@@ -0,0 +1,100 @@
+#include <atomic>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include "runtime.hpp"
+
+static std::atomic<bool> huge_pages{false};
+
+// Reads a core list like "2,4-7" into core numbers
+std::vector<int> parse_cores(const std::string& list) {
+    std::vector<int> cores;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string item = list.substr(start, end - start);
+        size_t dash = item.find('-');
+        size_t used = 0;
+        int first = std::stoi(item, &used);
+        int last = first;
+        if (dash != std::string::npos && used == dash) {
+            last = std::stoi(item.substr(dash + 1), &used);
+            used += dash + 1;
+        }
+        if (used != item.size() || first < 0 || last < first) {
+            throw std::invalid_argument("not a core list: " + list);
+        }
+        for (int core = first; core <= last; core++) {
+            cores.push_back(core);
+        }
+        start = end + 1;
+    }
+    return cores;
+}
+
+// Restricts the calling thread to the given cores; threads it starts afterwards inherit them.
+// Returns false if the kernel refused, e.g. a core that is offline or outside the cpuset.
+bool pin_thread(const std::vector<int>& cores) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int core : cores) {
+        if (core >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET(core, &cpus);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
+
+// Applies to blocks allocated from then on
+void set_huge_pages(bool enabled) {
+    huge_pages.store(enabled, std::memory_order_relaxed);
+}
+
+// Whether explicit huge pages can be mapped right now, i.e. some are reserved in
+// /proc/sys/vm/nr_hugepages. Without them allocate_pages falls back to transparent huge pages.
+bool probe_huge_pages() {
+    void* memory = mmap(nullptr, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    munmap(memory, HUGE_PAGE_SIZE);
+    return true;
+}
+
+// Blocks of a huge page or more are mapped directly, rounded up to whole huge pages. With huge
+// pages enabled they come from the reserved pool if it has room, otherwise from ordinary pages
+// the kernel is asked to back with transparent huge pages.
+void* allocate_pages(size_t bytes) {
+    if (bytes < HUGE_PAGE_SIZE) {
+        return ::operator new(bytes);
+    }
+    size_t size = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void* memory = MAP_FAILED;
+    bool huge = huge_pages.load(std::memory_order_relaxed);
+    if (huge) {
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (memory == MAP_FAILED) {
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        if (huge) {
+            madvise(memory, size, MADV_HUGEPAGE); // Only a hint; ignored where THP is off
+        }
+    }
+    return memory;
+}
+
+void free_pages(void* memory, size_t bytes) {
+    if (bytes < HUGE_PAGE_SIZE) {
+        ::operator delete(memory);
+        return;
+    }
+    size_t size = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    munmap(memory, size);
+}
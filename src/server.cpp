@@ -1,11 +1,42 @@
 #include <algorithm>
-#include <cpr/cpr.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include "json.hpp"
+#include "metrics.hpp"
 #include "server.hpp"
 
+// Keys of the replies written with JsonWriter, listed in the order their handlers used to set
+// them on a crow::json::wvalue so the bodies stay the same
+enum OrderField {ORDER_ID, ORDER_DIRECTION, ORDER_PRICE, ORDER_QUANTITY, ORDER_ASSET, ORDER_USER};
+static const JsonShape ORDER_SHAPE{"order_id", "direction", "price", "quantity", "asset", "user_id"};
+static const JsonShape MODIFIED_SHAPE{"order_id", "direction", "price", "quantity", "asset", "user_id", "fills"};
+static const size_t MODIFIED_FILLS = 6;
+enum FillField {FILL_QUANTITY, FILL_PRICE};
+static const JsonShape FILL_SHAPE{"quantity", "price"};
+enum CancelledField {CANCELLED_COUNT, CANCELLED_IDS};
+static const JsonShape CANCELLED_SHAPE{"cancelled", "order_ids"};
+enum CallbackField {CALLBACK_USER, CALLBACK_DIRECTION, CALLBACK_ASSET, CALLBACK_QUANTITY, CALLBACK_PRICE, CALLBACK_STATUS};
+static const JsonShape CALLBACK_SHAPE{"user", "direction", "asset", "quantity", "price", "status"};
+enum DepthField {DEPTH_ASSET, DEPTH_VERSION, DEPTH_BIDS, DEPTH_ASKS};
+static const JsonShape DEPTH_SHAPE{"asset", "version", "bids", "asks"}; // Always written in this order
+
+// Sends a body written into a per-thread buffer; copying it into the response is the only allocation
+static crow::response json_response(int code, const std::string& body) {
+    crow::response res(code);
+    res.set_header("Content-Type", "application/json");
+    res.body = body;
+    return res;
+}
+
 // Contructs a new orderbook server
-Server::Server(int port, Engine engine) : engine(std::move(engine)), port(port), cur_order_idx(0) {
+Server::Server(int port, Engine& engine, int threads, int binary_port, int snapshot_interval, int feed_refresh, bool cancel_on_disconnect, bool busy_poll) :
+    port(port), threads(threads), binary_port(binary_port), cancel_on_disconnect(cancel_on_disconnect), busy_poll(busy_poll),
+    snapshot_interval(snapshot_interval), feed_refresh(feed_refresh), engine(engine), cur_order_idx(0)
+{
     CROW_ROUTE(this->app, "/limit/<string>/<string>/<string>/<int>/<int>").methods(crow::HTTPMethod::POST)(
-        [this](std::string user, std::string direction, std::string asset, int quantity, int price){
+        [this](std::string user, std::string direction, std::string asset, int64_t quantity, int64_t price){
             bool dir;
             if (direction == "buy") {
                 dir = BUY;
@@ -14,17 +45,11 @@ Server::Server(int port, Engine engine) : engine(std::move(engine)), port(port),
             } else {
                 return crow::response(404);
             }
-            return this->limit_order(Order{
-                user,
-                dir,
-                asset,
-                quantity,
-                price,
-            });
+            return this->limit_order(user, dir, asset, quantity, price);
         }
     );
     CROW_ROUTE(this->app, "/market/<string>/<string>/<string>/<int>").methods(crow::HTTPMethod::POST)(
-        [this](std::string user, std::string direction, std::string asset, int quantity){
+        [this](std::string user, std::string direction, std::string asset, int64_t quantity){
             bool dir;
             if (direction == "buy") {
                 dir = BUY;
@@ -33,12 +58,7 @@ Server::Server(int port, Engine engine) : engine(std::move(engine)), port(port),
             } else {
                 return crow::response(404);
             }
-            return this->market_order(Order{
-                user,
-                dir,
-                asset,
-                quantity,
-            });
+            return this->market_order(user, dir, asset, quantity);
         }
     );
     CROW_ROUTE(this->app, "/user/<string>/<path>").methods(crow::HTTPMethod::POST)(
@@ -47,7 +67,7 @@ Server::Server(int port, Engine engine) : engine(std::move(engine)), port(port),
         }
     );
     CROW_ROUTE(this->app, "/orders/<string>/<string>/<int>").methods(crow::HTTPMethod::GET)(
-        [this](std::string direction, std::string asset, int price){
+        [this](std::string direction, std::string asset, int64_t price){
             bool dir;
             if (direction == "buy") {
                 dir = BUY;
@@ -59,6 +79,11 @@ Server::Server(int port, Engine engine) : engine(std::move(engine)), port(port),
             return this->get_orders(dir, asset, price);
         }
     );
+    CROW_ROUTE(this->app, "/depth/<string>/<int>").methods(crow::HTTPMethod::GET)(
+        [this](std::string asset, int levels){
+            return this->get_depth(asset, levels);
+        }
+    );
     CROW_ROUTE(this->app, "/books/<string>/<int>/<int>").methods(crow::HTTPMethod::POST)(
         [this](std::string asset, int min_price, int max_price){
             return this->add_orderbook(Market{
@@ -68,11 +93,102 @@ Server::Server(int port, Engine engine) : engine(std::move(engine)), port(port),
             });
         }
     );
+    CROW_ROUTE(this->app, "/books/<string>/<int>/<int>/<string>").methods(crow::HTTPMethod::POST)(
+        [this](std::string asset, int min_price, int max_price, std::string storage){
+            Storage store;
+            if (storage == "dense") {
+                store = DENSE;
+            } else if (storage == "paged") {
+                store = PAGED;
+            } else {
+                return crow::response(404);
+            }
+            return this->add_orderbook(Market{
+                asset,
+                min_price,
+                max_price,
+                store,
+            });
+        }
+    );
+    CROW_ROUTE(this->app, "/books/<string>/<int>/<int>/<string>/<int>").methods(crow::HTTPMethod::POST)(
+        [this](std::string asset, int min_price, int max_price, std::string storage, int64_t tick){
+            Storage store;
+            if (storage == "dense") {
+                store = DENSE;
+            } else if (storage == "paged") {
+                store = PAGED;
+            } else {
+                return crow::response(404);
+            }
+            if (tick < 1 || tick > static_cast<int64_t>(max_price) - min_price) {
+                crow::json::wvalue data;
+                data["message"] = "tick size must be between 1 and the price range";
+                return crow::response(400, data);
+            }
+            return this->add_orderbook(Market{
+                asset,
+                min_price,
+                max_price,
+                store,
+                static_cast<int>(tick),
+            });
+        }
+    );
     CROW_ROUTE(this->app, "/cancel/<int>").methods(crow::HTTPMethod::POST)(
-        [this](int order_id){
+        [this](int64_t order_id){
             return this->cancel_order(order_id);
         }
     );
+    CROW_ROUTE(this->app, "/cancel_all/<string>").methods(crow::HTTPMethod::POST)(
+        [this](std::string user){
+            return this->cancel_all(user, std::nullopt);
+        }
+    );
+    CROW_ROUTE(this->app, "/cancel_all/<string>/<string>").methods(crow::HTTPMethod::POST)(
+        [this](std::string user, std::string asset){
+            return this->cancel_all(user, asset);
+        }
+    );
+    CROW_ROUTE(this->app, "/modify/<int>/<int>/<int>").methods(crow::HTTPMethod::POST)(
+        [this](int64_t order_id, int64_t quantity, int64_t price){
+            return this->modify_order(order_id, quantity, price);
+        }
+    );
+    CROW_ROUTE(this->app, "/batch").methods(crow::HTTPMethod::POST)(
+        [this](const crow::request& req){
+            return this->run_batch(req.body);
+        }
+    );
+    CROW_ROUTE(this->app, "/snapshot").methods(crow::HTTPMethod::POST)(
+        [this](){
+            return this->take_snapshot();
+        }
+    );
+    // Each text message from the client is an asset to follow
+    CROW_WEBSOCKET_ROUTE(this->app, "/feed")
+        .onopen([](crow::websocket::connection&){})
+        .onclose([this](crow::websocket::connection& conn, const std::string&, auto...){
+            this->unsubscribe_all(conn);
+        })
+        .onmessage([this](crow::websocket::connection& conn, const std::string& data, bool){
+            this->subscribe(conn, data);
+        });
+    CROW_ROUTE(this->app, "/latency").methods(crow::HTTPMethod::GET)(
+        [this](){
+            return this->get_latency();
+        }
+    );
+    CROW_ROUTE(this->app, "/notifier").methods(crow::HTTPMethod::GET)(
+        [this](){
+            return this->get_notifier();
+        }
+    );
+    CROW_ROUTE(this->app, "/metrics").methods(crow::HTTPMethod::GET)(
+        [this](){
+            return this->get_metrics();
+        }
+    );
     CROW_ROUTE(this->app, "/shutdown").methods(crow::HTTPMethod::POST)(
         [this](){
             return this->shutdown();
@@ -81,129 +197,1000 @@ Server::Server(int port, Engine engine) : engine(std::move(engine)), port(port),
 }
 
 void Server::start_server() {
+    if (this->threads > 0) {
+        this->app.concurrency(this->threads);
+    }
+    if (this->binary_port > 0) {
+        this->gateway = std::make_unique<Gateway>(this->binary_port, *this, this->engine, this->cancel_on_disconnect, this->busy_poll);
+    }
+    if (this->snapshot_interval > 0 && this->journal) {
+        this->snapshotter = std::thread(&Server::run_snapshots, this);
+    }
+    {
+        std::lock_guard<std::mutex> guard(this->feed_lock);
+        this->feed = std::make_unique<Feed>(
+            [this](const FeedBatch& batch) { this->send_deltas(batch); },
+            [this](const std::vector<uint32_t>& assets) { this->send_books(assets); },
+            this->feed_refresh
+        );
+        this->engine.set_feed(this->feed.get());
+    }
+    this->engine.set_on_remove([this](uint32_t asset) { this->forget_depth(asset); });
     this->app.port(this->port).run();
+    if (this->snapshotter.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(this->snapshot_timer_lock);
+            this->stopping = true;
+        }
+        this->snapshot_wake.notify_one();
+        this->snapshotter.join();
+    }
+    if (this->gateway) {
+        this->gateway->stop(); // Join before clearing so a last order can't see a half-destroyed gateway
+        this->gateway.reset();
+    }
+    // Taken out under the lock but destroyed outside it, since its thread may be waiting on it
+    std::unique_ptr<Feed> feed;
+    {
+        std::lock_guard<std::mutex> guard(this->feed_lock);
+        feed = std::move(this->feed);
+        this->feed_clients.clear();
+    }
+    this->engine.set_feed(nullptr);
+    this->engine.set_on_remove({});
 }
 
 // Places a limit order
-crow::response Server::limit_order(Order order) {
+crow::response Server::limit_order(const std::string& user, bool direction, const std::string& asset, int64_t quantity, int64_t price) {
+    return this->enter_order(user, direction, asset, quantity, price, false);
+}
+
+// Places a market order
+crow::response Server::market_order(const std::string& user, bool direction, const std::string& asset, int64_t quantity) {
+    return this->enter_order(user, direction, asset, quantity, 0, true);
+}
+
+// Resolves a REST order's names and runs it through the shared entry path
+crow::response Server::enter_order(const std::string& user, bool direction, const std::string& asset, int64_t quantity, int64_t price, bool market) {
     crow::json::wvalue data;
-    if (!this->user_exists(order.user)) {
+    std::optional<uint32_t> user_id = this->find_user(user);
+    if (!user_id) {
         data["message"] = "user must be registered prior to placing an order";
         return crow::response(401, data);
     }
-    if (!this->engine.orderbook_exists(order.asset)) {
+    std::optional<uint32_t> asset_id = this->engine.get_asset_id(asset);
+    if (!asset_id) {
         data["message"] = "orderbook does not exist";
         return crow::response(404, data);
     }
-    if (
-        order.price < this->engine.get_min_price(order.asset) ||
-        order.price > this->engine.get_max_price(order.asset)
-    ) {
+    if (quantity < 0) {
+        data["message"] = "quantity must not be negative";
+        return crow::response(400, data);
+    }
+    if (price != static_cast<Price>(price)) {
         data["message"] = "price is out of bounds";
         return crow::response(400, data);
     }
 
+    // Strings stop here, the engine only sees interned ids
+    Order order{};
+    order.quantity = quantity;
+    order.price = price;
+    order.user = *user_id;
+    order.asset = *asset_id;
+    order.direction = direction;
+
+    thread_local std::vector<Fill> fills;
+    fills.clear();
+    RejectReason reason = this->accept_order(order, market);
+    if (reason == REJECT_NONE) {
+        reason = this->match_order(order, market, fills);
+    }
+    if (reason == REJECT_PRICE) {
+        data["message"] = "price is out of bounds";
+        return crow::response(400, data);
+    } else if (reason == REJECT_TICK) {
+        data["message"] = "price is not a multiple of the tick size";
+        return crow::response(400, data);
+    } else if (reason == REJECT_QUANTITY) {
+        data["message"] = "quantity is out of bounds";
+        return crow::response(400, data);
+    } else if (reason == REJECT_ORDER_IDS) {
+        data["message"] = "order ids are exhausted";
+        return crow::response(503, data);
+    } else if (reason == REJECT_UNKNOWN_BOOK) {
+        data["message"] = "orderbook does not exist"; // Removed since it was looked up
+        return crow::response(404, data);
+    }
+    this->report_fills(fills);
+    thread_local std::string body;
+    body.clear();
+    JsonWriter json(body);
+    json.begin_object();
+    json.key(ORDER_SHAPE, ORDER_ID);
+    json.value(order.order_id);
+    json.end_object();
+    return json_response(200, body);
+}
+
+// Validates an order whose user and asset are already resolved and assigns its id.
+// Shared by REST and the binary gateway.
+RejectReason Server::accept_order(Order& order, bool market) {
+    METRIC_TIMER(METRIC_VALIDATE);
+    if (order.quantity == 0 || order.quantity > MAX_QUANTITY) {
+        METRIC_COUNT(METRIC_REJECTED, 1);
+        return REJECT_QUANTITY;
+    }
+    // Market orders are sized and priced by the engine, against the book it's about to match on
+    if (!market && (
+        order.price < this->engine.get_min_price(order.asset) ||
+        order.price > this->engine.get_max_price(order.asset)
+    )) {
+        METRIC_COUNT(METRIC_REJECTED, 1);
+        return REJECT_PRICE;
+    }
+    if (!market && order.price % this->engine.get_tick(order.asset) != 0) {
+        METRIC_COUNT(METRIC_REJECTED, 1);
+        return REJECT_TICK;
+    }
+
     // set order_id to uuid
     order.order_id = this->cur_order_idx++;
-    data["order_id"] = order.order_id;
+    if (order.order_id > OrderLocations::MAX_ID) {
+        METRIC_COUNT(METRIC_REJECTED, 1);
+        return REJECT_ORDER_IDS;
+    }
+    METRIC_COUNT(METRIC_ACCEPTED, 1);
+    return REJECT_NONE;
+}
+
+// Matches an accepted order, appending its fills to `fills` for report_fills. The book refuses
+// an order its side's depth has no room for, so this can still reject. Callers keep one fills
+// vector per thread, so once it has grown to the largest sweep seen matching allocates nothing.
+RejectReason Server::match_order(Order& order, bool market, std::vector<Fill>& fills) {
+    return this->engine.place_order(order, fills, market);
+}
 
-    for (const Order& fill : this->engine.place_order(order)) {
+// Tells both sides of each fill
+void Server::report_fills(const std::vector<Fill>& fills) {
+    for (const Fill& fill : fills) {
         this->inform_user(fill);
     }
-    return crow::response(200, data);
 }
 
-// Places a market order
-crow::response Server::market_order(Order order) {
-    if (!this->engine.orderbook_exists(order.asset)) {
-        return this->limit_order(order);
+crow::response Server::cancel_order(uint64_t order_id) {
+    crow::json::wvalue data;
+    std::optional<Order> order = this->engine.cancel_order(order_id);
+    if (!order) {
+        data["message"] = "order not found";
+        return crow::response(204, data);
     }
+    thread_local std::string body;
+    body.clear();
+    JsonWriter json(body);
+    this->write_order(json, ORDER_SHAPE, *order, order->price, order->quantity, [](size_t) {});
+    return json_response(200, body);
+}
 
-    // Ensures that market orders don't "overflow" but lets us still use `limit_order()` functionality
-    if (order.direction == BUY) {
-        order.quantity = std::min((uint64_t) order.quantity, this->engine.get_sell_depth(order.asset));
-    } else {
-        order.quantity = std::min((uint64_t) order.quantity, this->engine.get_buy_depth(order.asset));
+// Writes the order fields of a cancel or modify reply, leaving any others in the shape to `extra`.
+// Price and quantity are passed in as a modify reports the new ones.
+template <typename F>
+void Server::write_order(JsonWriter& json, const JsonShape& shape, const Order& order, Price price, uint64_t quantity, F extra) {
+    json.begin_object();
+    for (size_t field : shape) {
+        json.key(shape, field);
+        switch (field) {
+            case ORDER_ID: json.value(order.order_id); break;
+            case ORDER_DIRECTION: json.value(order.direction ? "sell" : "buy"); break;
+            case ORDER_PRICE: json.value(price); break;
+            case ORDER_QUANTITY: json.value(quantity); break;
+            case ORDER_ASSET: json.value(this->engine.get_asset_name(order.asset)); break;
+            case ORDER_USER: json.value(this->get_user_name(order.user)); break;
+            default: extra(field); break;
+        }
     }
+    json.end_object();
+}
 
-    if (order.direction == BUY) {
-        order.price = this->engine.get_max_price(order.asset);
-    } else {
-        order.price = this->engine.get_min_price(order.asset);
+// Cancels every order a user has resting, or only those in one book, in a single engine pass.
+// The user needs no list of their order ids, so it also works as a kill switch.
+crow::response Server::cancel_all(const std::string& user, const std::optional<std::string>& asset) {
+    crow::json::wvalue data;
+    std::optional<uint32_t> user_id = this->find_user(user);
+    if (!user_id) {
+        data["message"] = "user does not exist";
+        return crow::response(404, data);
+    }
+    std::optional<uint32_t> asset_id;
+    if (asset) {
+        asset_id = this->engine.get_asset_id(*asset);
+        if (!asset_id) {
+            data["message"] = "orderbook does not exist";
+            return crow::response(404, data);
+        }
     }
 
-    return this->limit_order(order);
+    thread_local std::vector<Order> cancelled;
+    cancelled.clear();
+    this->engine.cancel_user(*user_id, asset_id, cancelled);
+    thread_local std::string body;
+    body.clear();
+    JsonWriter json(body);
+    json.begin_object();
+    for (size_t field : CANCELLED_SHAPE) {
+        json.key(CANCELLED_SHAPE, field);
+        if (field == CANCELLED_COUNT) {
+            json.value(cancelled.size());
+            continue;
+        }
+        json.begin_array();
+        for (const Order& order : cancelled) {
+            json.value(order.order_id);
+        }
+        json.end_array();
+    }
+    json.end_object();
+    return json_response(200, body);
 }
 
-crow::response Server::cancel_order(int order_id) {
+// Changes a resting order's size or price in place of a cancel and a new order. The order keeps
+// its id, and keeps its place in line if only its size went down.
+crow::response Server::modify_order(uint64_t order_id, int64_t quantity, int64_t price) {
     crow::json::wvalue data;
-    std::optional<Order> order = this->engine.cancel_order(order_id);
+    if (quantity < 0) {
+        data["message"] = "quantity must not be negative";
+        return crow::response(400, data);
+    }
+    if (static_cast<uint64_t>(quantity) > MAX_QUANTITY) {
+        data["message"] = "quantity is out of bounds";
+        return crow::response(400, data);
+    }
+    std::optional<uint32_t> asset = this->engine.get_order_asset(order_id);
+    if (!asset) {
+        data["message"] = "order not found";
+        return crow::response(204, data);
+    }
+    if (
+        price != static_cast<Price>(price) ||
+        price < this->engine.get_min_price(*asset) ||
+        price > this->engine.get_max_price(*asset)
+    ) {
+        data["message"] = "price is out of bounds";
+        return crow::response(400, data);
+    }
+    if (price % this->engine.get_tick(*asset) != 0) {
+        data["message"] = "price is not a multiple of the tick size";
+        return crow::response(400, data);
+    }
+
+    thread_local std::vector<Fill> fills;
+    fills.clear();
+    RejectReason reason;
+    std::optional<Order> order = this->engine.modify_order(order_id, quantity, price, fills, reason);
+    if (reason == REJECT_QUANTITY) {
+        data["message"] = "quantity is out of bounds";
+        return crow::response(400, data);
+    }
     if (!order) {
         data["message"] = "order not found";
         return crow::response(204, data);
     }
-    data["order_id"] = order->order_id;
-    data["direction"] = order->direction ? "sell" : "buy";
-    data["price"] = order->price;
-    data["quantity"] = order->quantity;
-    data["asset"] = order->asset;
-    data["user_id"] = order->user;
+    for (const Fill& fill : fills) {
+        this->inform_user(fill);
+    }
+    thread_local std::string body;
+    body.clear();
+    JsonWriter json(body);
+    this->write_order(json, MODIFIED_SHAPE, *order, price, quantity, [&](size_t) {
+        json.begin_array();
+        for (const Fill& fill : fills) {
+            json.begin_object();
+            for (size_t field : FILL_SHAPE) {
+                json.key(FILL_SHAPE, field);
+                if (field == FILL_QUANTITY) {
+                    json.value(fill.quantity);
+                } else {
+                    json.value(fill.price);
+                }
+            }
+            json.end_object();
+        }
+        json.end_array();
+    });
+    return json_response(200, body);
+}
+
+// Runs a list of limit/market/cancel commands for one user in a single engine pass.
+// Results come back in submission order, each with the status its REST endpoint would give.
+crow::response Server::run_batch(const std::string& body) {
+    crow::json::wvalue data;
+    crow::json::rvalue request = crow::json::load(body);
+    if (
+        !request || request.t() != crow::json::type::Object ||
+        !request.has("user") || !request.has("commands") ||
+        request["commands"].t() != crow::json::type::List
+    ) {
+        data["message"] = "expected {\"user\": ..., \"commands\": [...]}";
+        return crow::response(400, data);
+    }
+    std::optional<uint32_t> user_id = this->find_user(request["user"].s());
+    if (!user_id) {
+        data["message"] = "user must be registered prior to placing an order";
+        return crow::response(401, data);
+    }
+
+    // Each asset is resolved once, however many commands use it
+    struct Book {
+        std::optional<uint32_t> id;
+        int min;
+        int max;
+        int tick;
+    };
+    std::unordered_map<std::string, Book> books;
+    crow::json::rvalue commands = request["commands"];
+    size_t size = commands.size();
+    std::vector<BatchEntry> batch;
+    std::vector<int> status(size, 200);
+    std::vector<const char*> errors(size, nullptr);
+    std::vector<size_t> positions; // Index in the request of each entry in batch
+    batch.reserve(size);
+    try {
+        for (size_t i = 0; i < size; i++) {
+            const crow::json::rvalue& command = commands[i];
+            std::string type = command["type"].s();
+            BatchEntry entry{};
+            entry.order.user = *user_id;
+            int64_t price = 0;
+            if (type == "cancel") {
+                entry.action = BATCH_CANCEL;
+                entry.order.order_id = command["order_id"].i();
+                batch.push_back(entry);
+                positions.push_back(i);
+                continue;
+            } else if (type == "limit") {
+                entry.action = BATCH_LIMIT;
+                price = command["price"].i();
+            } else if (type == "market") {
+                entry.action = BATCH_MARKET;
+            } else {
+                status[i] = 404;
+                errors[i] = "unknown command type";
+                continue;
+            }
+
+            std::string direction = command["direction"].s();
+            if (direction != "buy" && direction != "sell") {
+                status[i] = 404;
+                errors[i] = "direction must be buy or sell";
+                continue;
+            }
+            std::string asset = command["asset"].s();
+            auto it = books.find(asset);
+            if (it == books.end()) {
+                Book book{this->engine.get_asset_id(asset), 0, 0, 1};
+                if (book.id) {
+                    book.min = this->engine.get_min_price(*book.id);
+                    book.max = this->engine.get_max_price(*book.id);
+                    book.tick = this->engine.get_tick(*book.id);
+                }
+                it = books.emplace(asset, book).first;
+            }
+            if (!it->second.id) {
+                status[i] = 404;
+                errors[i] = "orderbook does not exist";
+                continue;
+            }
+            int64_t quantity = command["quantity"].i();
+            if (quantity < 0) {
+                status[i] = 400;
+                errors[i] = "quantity must not be negative";
+                continue;
+            }
+            if (quantity == 0 || static_cast<uint64_t>(quantity) > MAX_QUANTITY) {
+                status[i] = 400;
+                errors[i] = "quantity is out of bounds";
+                continue;
+            }
+            if (type == "limit" && (price < it->second.min || price > it->second.max)) {
+                status[i] = 400;
+                errors[i] = "price is out of bounds";
+                continue;
+            }
+            if (price % it->second.tick != 0) {
+                status[i] = 400;
+                errors[i] = "price is not a multiple of the tick size";
+                continue;
+            }
+            entry.order.price = price;
+            entry.order.quantity = quantity;
+            entry.order.asset = *it->second.id;
+            entry.order.direction = direction == "sell" ? SELL : BUY;
+            entry.order.order_id = this->cur_order_idx++;
+            if (entry.order.order_id > OrderLocations::MAX_ID) {
+                status[i] = 503;
+                errors[i] = "order ids are exhausted";
+                continue;
+            }
+            batch.push_back(entry);
+            positions.push_back(i);
+        }
+    } catch (const std::runtime_error&) {
+        data["message"] = "malformed command";
+        return crow::response(400, data);
+    }
+
+    std::vector<Fill> batch_fills;
+    this->engine.run_batch(batch, batch_fills);
+
+    std::vector<crow::json::wvalue> results(size);
+    for (size_t i = 0; i < size; i++) {
+        if (errors[i]) {
+            results[i]["status"] = status[i];
+            results[i]["message"] = errors[i];
+        }
+    }
+    for (size_t j = 0; j < batch.size(); j++) {
+        const BatchEntry& entry = batch[j];
+        crow::json::wvalue& result = results[positions[j]];
+        if (entry.action == BATCH_CANCEL) {
+            if (!entry.done) {
+                result["status"] = 204;
+                result["message"] = "order not found";
+                continue;
+            }
+            result["status"] = 200;
+            result["order_id"] = entry.order.order_id;
+            result["direction"] = entry.order.direction ? "sell" : "buy";
+            result["price"] = entry.order.price;
+            result["quantity"] = entry.order.quantity;
+            result["asset"] = this->engine.get_asset_name(entry.order.asset);
+            result["user_id"] = this->get_user_name(entry.order.user);
+            continue;
+        }
+        if (entry.reason == REJECT_QUANTITY) {
+            result["status"] = 400;
+            result["message"] = "quantity is out of bounds";
+            continue;
+        }
+        if (entry.reason == REJECT_UNKNOWN_BOOK) {
+            result["status"] = 404;
+            result["message"] = "orderbook does not exist"; // Removed while the batch was queued
+            continue;
+        }
+        result["status"] = 200;
+        result["order_id"] = entry.order.order_id;
+        std::vector<crow::json::wvalue> fills;
+        for (size_t k = entry.first_fill; k < entry.first_fill + entry.fill_count; k++) {
+            const Fill& fill = batch_fills[k];
+            this->inform_user(fill);
+            crow::json::wvalue filled;
+            filled["quantity"] = fill.quantity;
+            filled["price"] = fill.price;
+            fills.push_back(std::move(filled));
+        }
+        result["fills"] = std::move(fills);
+    }
+    data["results"] = std::move(results);
     return crow::response(200, data);
 }
 
 // Updates the callback for when a user is filled
 crow::response Server::update_user(const std::string& user_id, const std::string& callback) {
-    bool ret = this->user_exists(user_id);
     crow::json::wvalue data;
-    this->users[user_id] = callback;
+    if (this->journal && sizeof(UserRecord) + user_id.size() + callback.size() > UINT16_MAX) {
+        data["message"] = "user id and callback are too long";
+        return crow::response(400, data);
+    }
+    uint64_t seq = 0;
+    std::unique_lock<std::shared_mutex> lock(this->users_lock);
+    bool ret = this->users.find(user_id).has_value();
+    this->register_user(user_id, callback);
+    if (this->journal) {
+        // Appended under the lock so replay interns users in the same order
+        UserRecord record{static_cast<uint32_t>(user_id.size())};
+        std::string payload(reinterpret_cast<const char*>(&record), sizeof(record));
+        payload += user_id;
+        payload += callback;
+        seq = this->journal->append(RECORD_USER, payload.data(), payload.size());
+    }
+    lock.unlock();
+    if (this->journal) {
+        this->journal->commit(seq);
+    }
     data["already_registered"] = ret;
     return crow::response(200, data);
 }
 
+// Callers must hold users_lock exclusively
+void Server::register_user(const std::string& user_id, const std::string& callback) {
+    uint32_t id = this->users.intern(user_id);
+    if (id >= this->callbacks.size()) {
+        this->callbacks.resize(id + 1);
+    }
+    this->callbacks[id] = callback;
+}
+
+// Rebuilds users, books and resting orders from the latest snapshot and the journal after it,
+// then starts journaling new changes. Must run before the server starts. Returns the number
+// of journal records replayed.
+uint64_t Server::recover(Journal& journal) {
+    uint64_t records = 0;
+    uint64_t next_order = 0;
+    uint64_t after = 0;
+    uint64_t users_seq = 0;
+    uint64_t directory_seq = 0;
+    std::unique_lock<std::shared_mutex> lock(this->users_lock);
+    std::string path = find_snapshot(journal.get_directory());
+    if (!path.empty()) {
+        SnapshotFile snapshot(path);
+        const SnapshotHeader& header = snapshot.get_header();
+        for (const auto& [name, callback] : snapshot.get_users()) {
+            this->register_user(name, callback);
+        }
+        this->engine.load(snapshot.get_assets(), snapshot.get_books());
+        next_order = header.next_order;
+        after = header.seq;
+        users_seq = header.users_seq;
+        directory_seq = header.directory_seq;
+        std::cerr << "Loaded snapshot " << path << std::endl;
+    }
+
+    // Parts of the snapshot were taken at different points, so some records just after it
+    // are already reflected; books filter their own orders
+    journal.replay(after, [&](const RecordHeader& header, const char* payload) {
+        records++;
+        if (header.type == RECORD_USER) {
+            if (header.seq <= users_seq) {
+                return;
+            }
+            UserRecord record;
+            std::memcpy(&record, payload, sizeof(record));
+            const char* name = payload + sizeof(record);
+            std::string callback(name + record.name_length, header.length - sizeof(record) - record.name_length);
+            this->register_user(std::string(name, record.name_length), callback);
+            return;
+        }
+        if ((header.type == RECORD_BOOK || header.type == RECORD_REMOVE) && header.seq <= directory_seq) {
+            return;
+        }
+        if (header.type == RECORD_ORDER) {
+            Order order;
+            std::memcpy(&order, payload, sizeof(order));
+            next_order = std::max(next_order, order.order_id + 1);
+        }
+        this->engine.restore(header, payload);
+    });
+    this->cur_order_idx = next_order;
+    this->journal = &journal;
+    this->engine.set_journal(&journal);
+    return records;
+}
+
+// Writes a snapshot next to the journal, then drops older snapshots and the journal
+// segments it makes redundant. Returns the journal seq it covers.
+uint64_t Server::snapshot() {
+    std::lock_guard<std::mutex> guard(this->snapshot_lock);
+    SnapshotImage image{};
+    {
+        std::shared_lock<std::shared_mutex> lock(this->users_lock);
+        image.header.users_seq = this->journal->get_last_seq();
+        for (uint32_t id = 0; id < this->users.get_size(); id++) {
+            image.users.emplace_back(this->users.get_name(id), this->callbacks[id]);
+        }
+    }
+    image.header.directory_seq = this->engine.capture(image.assets, image.books);
+    image.header.next_order = this->cur_order_idx; // Read after the books, so it's past every id in them
+
+    // Everything up to the earliest of the capture points is covered
+    image.header.seq = std::min(image.header.users_seq, image.header.directory_seq);
+    for (const BookImage& book : image.books) {
+        image.header.seq = std::min(image.header.seq, book.state.seq);
+    }
+    const std::string& directory = this->journal->get_directory();
+    std::string path = snapshot_path(directory, image.header.seq);
+    write_snapshot(path, image);
+    remove_snapshots(directory, path);
+    this->journal->discard(image.header.seq);
+    return image.header.seq;
+}
+
+// Takes a snapshot now
+crow::response Server::take_snapshot() {
+    crow::json::wvalue data;
+    if (!this->journal) {
+        data["message"] = "snapshots need a journal";
+        return crow::response(400, data);
+    }
+    data["seq"] = this->snapshot();
+    return crow::response(200, data);
+}
+
+// Writes a snapshot every snapshot_interval seconds until the server stops
+void Server::run_snapshots() {
+    std::unique_lock<std::mutex> lock(this->snapshot_timer_lock);
+    auto interval = std::chrono::seconds(this->snapshot_interval);
+    while (!this->snapshot_wake.wait_for(lock, interval, [this] { return this->stopping; })) {
+        try {
+            this->snapshot();
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl; // Try again next time; the journal still has everything
+        }
+    }
+}
+
 // Adds orderbook to the engine
 crow::response Server::add_orderbook(const Market& market) {
     this->engine.add_orderbook(market);
     return crow::response(200);
 }
 
-// Pings user when request is fulfilled
-int Server::inform_user(const Order& fill) {
-    std::string callback_url = this->users[fill.user];
+// Queues a callback to the user for a fill; delivery happens on the notifier's threads
+void Server::inform_user(const Fill& fill) {
+    METRIC_TIMER(METRIC_INFORM);
+    std::string maker_url, maker, taker_url, taker;
+    {
+        std::shared_lock<std::shared_mutex> lock(this->users_lock);
+        maker_url = this->callbacks[fill.maker_user];
+        maker = this->users.get_name(fill.maker_user);
+        taker_url = this->callbacks[fill.taker_user];
+        taker = this->users.get_name(fill.taker_user);
+    }
+    const std::string& asset = this->engine.get_asset_name(fill.asset);
+
+    // Maker first, then taker, each seeing its own direction
+    thread_local std::string body;
+    for (bool maker_side : {true, false}) {
+        body.clear();
+        JsonWriter json(body);
+        json.begin_object();
+        for (size_t field : CALLBACK_SHAPE) {
+            json.key(CALLBACK_SHAPE, field);
+            switch (field) {
+                case CALLBACK_USER: json.value(maker_side ? maker : taker); break;
+                case CALLBACK_DIRECTION: json.value(fill.aggressor == maker_side ? "buy" : "sell"); break;
+                case CALLBACK_ASSET: json.value(asset); break;
+                case CALLBACK_QUANTITY: json.value(fill.quantity); break;
+                case CALLBACK_PRICE: json.value(fill.price); break;
+                case CALLBACK_STATUS: json.value("filled"); break;
+            }
+        }
+        json.end_object();
+        if (maker_side) {
+            this->notifier.notify(fill.maker_user, maker_url, body);
+        } else {
+            this->notifier.notify(fill.taker_user, taker_url, body);
+        }
+    }
+    if (this->gateway) {
+        this->gateway->publish(fill);
+    }
+}
+
+// Gets orders up/down to a certain price
+crow::response Server::get_orders(bool direction, const std::string& asset, int64_t price) {
     crow::json::wvalue data;
+    std::optional<uint32_t> asset_id = this->engine.get_asset_id(asset);
+    if (!asset_id) {
+        data["message"] = "orderbook does not exist";
+        return crow::response(404, data);
+    }
 
-    data["user"] = fill.user;
-    data["direction"] =  fill.direction ? "sell" : "buy";
-    data["asset"] = fill.asset;
-    data["quantity"] = fill.quantity;
-    data["price"] = fill.price;
-    data["status"] = "filled";
-    cpr::Response r = cpr::Post(
-        cpr::Url{callback_url},
-        cpr::Body{data.dump()},
-        cpr::Header{{"Content-Type", "application/json"}}
-    );
+    // Any bound past the price type's range covers the whole side anyway
+    int bound = std::clamp<int64_t>(price, std::numeric_limits<Price>::min(), std::numeric_limits<Price>::max());
+    std::unordered_map<int, uint64_t> orders = this->engine.get_orders(direction, *asset_id, bound);
+    thread_local std::string body;
+    body.clear();
+    JsonWriter json(body);
+    if (orders.empty()) {
+        json.null(); // What wvalue dumps for an object nothing was put in
+        return json_response(200, body);
+    }
+    json.begin_object();
+    for (const auto& [level, quantity] : orders) {
+        json.key(level); // At most the touch, so there is no key order to follow
+        json.value(quantity);
+    }
+    json.end_object();
+    return json_response(200, body);
+}
 
-    return r.status_code;
+// Writes `count` price levels as a JSON array of [price, quantity] pairs
+static void write_depth(JsonWriter& json, const PriceLevel* levels, size_t count) {
+    json.begin_array();
+    for (size_t i = 0; i < count; i++) {
+        json.begin_array();
+        json.value(levels[i].price);
+        json.value(levels[i].quantity);
+        json.end_array();
+    }
+    json.end_array();
 }
 
-// Gets orders up/down to a certain price
-crow::response Server::get_orders(bool direction, const std::string& asset, int price) {
+// Gets the best `levels` bid and ask levels, best first, from the book's published top. The
+// reply is kept until the top's version moves, so repeated requests in between just copy it.
+crow::response Server::get_depth(const std::string& asset, int levels) {
     crow::json::wvalue data;
-    if (!this->engine.orderbook_exists(asset)) {
+    std::optional<uint32_t> asset_id = this->engine.get_asset_id(asset);
+    if (!asset_id) {
         data["message"] = "orderbook does not exist";
         return crow::response(404, data);
     }
+    if (levels < 1 || static_cast<size_t>(levels) > this->engine.get_depth_limit()) {
+        data["message"] = "levels must be between 1 and " + std::to_string(this->engine.get_depth_limit());
+        return crow::response(400, data);
+    }
+
+    crow::response res(200);
+    res.set_header("Content-Type", "application/json");
+    BookTop top = this->engine.get_top(*asset_id);
+    {
+        std::lock_guard<std::mutex> guard(this->depth_lock);
+        auto it = this->depth_cache.find({*asset_id, levels});
+        if (it != this->depth_cache.end() && it->second.version == top.version) {
+            res.body = it->second.body;
+            return res;
+        }
+    }
 
-    std::unordered_map<int, int> orders = this->engine.get_orders(direction, asset, price);
-    for (const auto& [price, quantity] : orders) {
-        data[std::to_string(price)] = quantity;
+    thread_local std::string body;
+    body.clear();
+    JsonWriter json(body);
+    json.begin_object();
+    json.key(DEPTH_SHAPE, DEPTH_ASSET);
+    json.value(asset);
+    json.key(DEPTH_SHAPE, DEPTH_VERSION);
+    json.value(top.version);
+    json.key(DEPTH_SHAPE, DEPTH_BIDS);
+    write_depth(json, top.bids, std::min<size_t>(top.bid_count, levels));
+    json.key(DEPTH_SHAPE, DEPTH_ASKS);
+    write_depth(json, top.asks, std::min<size_t>(top.ask_count, levels));
+    json.end_object();
+    res.body = body;
+    std::lock_guard<std::mutex> guard(this->depth_lock);
+    CachedDepth& cached = this->depth_cache[{*asset_id, levels}];
+    if (top.version >= cached.version) {
+        cached = CachedDepth{top.version, res.body};
     }
+    return res;
+}
+
+// Drops the cached depth replies of a removed book, for every level count
+void Server::forget_depth(uint32_t asset) {
+    std::lock_guard<std::mutex> guard(this->depth_lock);
+    this->depth_cache.erase(this->depth_cache.lower_bound({asset, 0}), this->depth_cache.lower_bound({asset + 1, 0}));
+}
+
+// Reports how long commands wait in the shard rings before matching starts
+crow::response Server::get_latency() {
+    crow::json::wvalue data;
+    Histogram latency;
+    this->engine.get_latency(latency);
+    data["count"] = latency.get_count();
+    data["p50_ns"] = latency.percentile(0.5);
+    data["p99_ns"] = latency.percentile(0.99);
+    data["p999_ns"] = latency.percentile(0.999);
+    data["max_ns"] = latency.get_max();
     return crow::response(200, data);
 }
 
+// Reports the fill callback backlog
+crow::response Server::get_notifier() {
+    crow::json::wvalue data;
+    NotifierStats stats = this->notifier.get_stats();
+    data["pending"] = stats.pending;
+    data["queued"] = stats.queued;
+    data["sent"] = stats.sent;
+    data["batches"] = stats.batches;
+    data["retries"] = stats.retries;
+    data["failed"] = stats.failed;
+    data["dropped"] = stats.dropped;
+    return crow::response(200, data);
+}
+
+// Appends one Prometheus sample line; labels, if any, go in as written, e.g. {shard="0"}
+static void append_sample(std::string& out, const std::string& name, const std::string& labels, double value) {
+    char number[32];
+    std::snprintf(number, sizeof(number), "%.9g", value);
+    out += name;
+    out += labels;
+    out += " ";
+    out += number;
+    out += "\n";
+}
+
+static void append_header(std::string& out, const std::string& name, const char* type, const char* help) {
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+// Appends a histogram as a Prometheus summary, with values multiplied by scale
+static void append_summary(std::string& out, const std::string& name, const char* help, Histogram& samples, double scale) {
+    append_header(out, name, "summary", help);
+    for (const char* quantile : {"0.5", "0.9", "0.99", "0.999"}) {
+        append_sample(out, name, std::string("{quantile=\"") + quantile + "\"}", samples.percentile(std::stod(quantile)) * scale);
+    }
+    append_sample(out, name + "_sum", "", samples.get_sum() * scale);
+    append_sample(out, name + "_count", "", samples.get_count());
+}
+
+// Reports the hot-path metrics every thread has recorded, along with queue depths and the
+// callback backlog, in Prometheus' text format
+crow::response Server::get_metrics() {
+    crow::response res(200);
+    res.set_header("Content-Type", "text/plain; version=0.0.4");
+    std::string& out = res.body;
+
+#ifndef ORDERBOOK_NO_METRICS
+    ThreadMetrics totals;
+    Metrics::collect(totals);
+    const double seconds = 1e-9 / Metrics::ticks_per_ns(); // Per tick
+    struct {
+        MetricCounter counter;
+        const char* name;
+        const char* help;
+    } counters[] = {
+        {METRIC_ACCEPTED, "orderbook_orders_accepted_total", "Orders that passed validation"},
+        {METRIC_REJECTED, "orderbook_orders_rejected_total", "Orders refused by validation"},
+        {METRIC_FILLS, "orderbook_fills_total", "Executions between a resting and an incoming order"},
+        {METRIC_CANCELLED, "orderbook_cancels_total", "Cancels that removed a resting order"},
+        {METRIC_CANCEL_MISSES, "orderbook_cancel_misses_total", "Cancels for orders that were no longer resting"},
+        {METRIC_MODIFIED, "orderbook_modifies_total", "Modifies that changed a resting order"},
+        {METRIC_MODIFY_MISSES, "orderbook_modify_misses_total", "Modifies for orders that were no longer resting"},
+    };
+    for (const auto& counter : counters) {
+        append_header(out, counter.name, "counter", counter.help);
+        append_sample(out, counter.name, "", totals.counters[counter.counter].load());
+    }
+    append_summary(out, "orderbook_validate_seconds", "Time validating an order", totals.samples[METRIC_VALIDATE], seconds);
+    append_summary(out, "orderbook_place_order_seconds", "Time in Engine::place_order, including the wait for its shard", totals.samples[METRIC_PLACE], seconds);
+    append_summary(out, "orderbook_cancel_order_seconds", "Time in Orderbook::cancel_order", totals.samples[METRIC_CANCEL], seconds);
+    append_summary(out, "orderbook_inform_user_seconds", "Time queueing a fill for its user", totals.samples[METRIC_INFORM], seconds);
+    append_summary(out, "orderbook_levels_swept", "Price levels an aggressive order took liquidity from", totals.samples[METRIC_SWEPT], 1);
+#endif
+
+    Histogram wait;
+    this->engine.get_latency(wait);
+    append_summary(out, "orderbook_shard_wait_seconds", "Time commands wait in a shard ring before matching", wait, 1e-9);
+    std::vector<size_t> depths;
+    this->engine.get_queue_depths(depths);
+    append_header(out, "orderbook_shard_queue_depth", "gauge", "Commands waiting in each shard ring");
+    for (size_t i = 0; i < depths.size(); i++) {
+        append_sample(out, "orderbook_shard_queue_depth", "{shard=\"" + std::to_string(i) + "\"}", depths[i]);
+    }
+    append_header(out, "orderbook_order_locations_bytes", "gauge", "Memory held by the table locating resting orders by id");
+    append_sample(out, "orderbook_order_locations_bytes", "", this->engine.get_location_bytes());
+
+    NotifierStats stats = this->notifier.get_stats();
+    append_header(out, "orderbook_callbacks_pending", "gauge", "Fills waiting to be sent to their user");
+    append_sample(out, "orderbook_callbacks_pending", "", stats.pending);
+    append_header(out, "orderbook_callbacks_sent_total", "counter", "Fills delivered to their user");
+    append_sample(out, "orderbook_callbacks_sent_total", "", stats.sent);
+    append_header(out, "orderbook_callbacks_failed_total", "counter", "Fills given up on after the last retry");
+    append_sample(out, "orderbook_callbacks_failed_total", "", stats.failed);
+    append_header(out, "orderbook_callbacks_dropped_total", "counter", "Fills refused because the callback backlog was full");
+    append_sample(out, "orderbook_callbacks_dropped_total", "", stats.dropped);
+    return res;
+}
+
+// Appends one feed message to out. Levels are [side, price, quantity], a quantity of 0 meaning
+// the level is now empty.
+static void append_levels(std::string& out, const char* type, const std::string& asset, uint64_t seq, const LevelDelta* levels, size_t count) {
+    out += "{\"type\":\"";
+    out += type;
+    out += "\",\"asset\":\"";
+    out += asset;
+    out += "\",\"seq\":";
+    out += std::to_string(seq);
+    out += ",\"levels\":[";
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) out += ",";
+        out += levels[i].direction == BUY ? "[\"buy\"," : "[\"sell\",";
+        out += std::to_string(levels[i].price);
+        out += ",";
+        out += std::to_string(levels[i].quantity);
+        out += "]";
+    }
+    out += "]}";
+}
+
+// Starts sending a feed connection asset's levels; its book follows from the feed's thread
+void Server::subscribe(crow::websocket::connection& conn, const std::string& asset) {
+    std::optional<uint32_t> asset_id = this->engine.get_asset_id(asset);
+    std::lock_guard<std::mutex> guard(this->feed_lock);
+    if (!this->feed) {
+        return;
+    }
+    if (!asset_id) {
+        conn.send_text("[{\"type\":\"error\",\"message\":\"orderbook does not exist\"}]");
+        return;
+    }
+    std::unordered_map<uint32_t, bool>& assets = this->feed_clients[&conn];
+    if (assets.emplace(*asset_id, false).second) {
+        this->feed->subscribe(*asset_id);
+    }
+}
+
+void Server::unsubscribe_all(crow::websocket::connection& conn) {
+    std::lock_guard<std::mutex> guard(this->feed_lock);
+    auto it = this->feed_clients.find(&conn);
+    if (it == this->feed_clients.end()) {
+        return;
+    }
+    for (const auto& [asset, ready] : it->second) {
+        this->feed->unsubscribe(asset);
+    }
+    this->feed_clients.erase(it);
+}
+
+// Runs on the feed's thread. Each message is built once; every connection then gets the ones
+// for assets it has a book for, as a single frame holding a JSON array.
+void Server::send_deltas(const FeedBatch& batch) {
+    std::unordered_map<uint32_t, std::string> names;
+    std::vector<std::string> messages(batch.updates.size());
+    for (size_t i = 0; i < batch.updates.size(); i++) {
+        const FeedUpdate& update = batch.updates[i];
+        auto [name, added] = names.try_emplace(update.asset);
+        if (added) {
+            name->second = crow::json::escape(this->engine.get_asset_name(update.asset));
+        }
+        append_levels(messages[i], "delta", name->second, update.seq, &batch.levels[update.first], update.count);
+    }
+
+    std::lock_guard<std::mutex> guard(this->feed_lock);
+    std::string frame;
+    for (auto& [conn, assets] : this->feed_clients) {
+        frame.clear();
+        for (size_t i = 0; i < batch.updates.size(); i++) {
+            auto it = assets.find(batch.updates[i].asset);
+            if (it == assets.end() || !it->second) {
+                continue;
+            }
+            frame += frame.empty() ? "[" : ",";
+            frame += messages[i];
+        }
+        if (!frame.empty()) {
+            frame += "]";
+            conn->send_text(frame);
+        }
+    }
+}
+
+// Runs on the feed's thread. Sends each asset's full book to everyone following it, after
+// which they're sent its deltas too.
+void Server::send_books(const std::vector<uint32_t>& assets) {
+    std::vector<LevelDelta> levels;
+    for (uint32_t asset : assets) {
+        levels.clear();
+        uint64_t seq = this->engine.get_levels(asset, levels);
+        std::string frame = "[";
+        append_levels(frame, "book", crow::json::escape(this->engine.get_asset_name(asset)), seq, levels.data(), levels.size());
+        frame += "]";
+
+        std::lock_guard<std::mutex> guard(this->feed_lock);
+        for (auto& [conn, subscribed] : this->feed_clients) {
+            auto it = subscribed.find(asset);
+            if (it != subscribed.end()) {
+                conn->send_text(frame);
+                it->second = true;
+            }
+        }
+    }
+}
+
 // Checks if a user exists
 bool Server::user_exists(const std::string& user_id) {
-    return this->users.find(user_id) != this->users.end();
+    return this->find_user(user_id).has_value();
+}
+
+// Resolves a registered user's name to the id used in orders
+std::optional<uint32_t> Server::find_user(const std::string& user_id) {
+    std::shared_lock<std::shared_mutex> lock(this->users_lock);
+    return this->users.find(user_id);
+}
+
+std::string Server::get_user_name(uint32_t user) {
+    std::shared_lock<std::shared_mutex> lock(this->users_lock);
+    return this->users.get_name(user);
 }
 
 // Shuts down the server
@@ -0,0 +1,82 @@
+#include <chrono>
+#include "runtime.hpp"
+#include "shard.hpp"
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+// Spins briefly then yields until the shard has run the job
+void Job::wait() {
+    for (int spins = 0; !this->done.load(std::memory_order_acquire); spins++) {
+        if (spins > 64) std::this_thread::yield();
+    }
+}
+
+Shard::Shard(int core, bool busy_poll) : ring(RING_SIZE), busy_poll(busy_poll), running(true), sleeping(false) {
+    this->thread = std::thread(&Shard::run, this, core);
+}
+
+Shard::~Shard() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->running.store(false);
+    }
+    this->wake.notify_one();
+    this->thread.join();
+}
+
+// Safe to call from any thread
+void Shard::submit(Job* job) {
+    size_t seq = this->ring.claim();
+    this->ring[seq] = Command{job, now_ns()};
+    this->ring.publish(seq);
+    std::atomic_thread_fence(std::memory_order_seq_cst); // Publish before checking `sleeping`
+    if (this->sleeping.load()) {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->wake.notify_one();
+    }
+}
+
+Histogram& Shard::get_latency() {
+    return this->latency;
+}
+
+// Commands submitted but not yet run; any thread
+size_t Shard::get_pending() {
+    return this->ring.get_pending();
+}
+
+void Shard::run(int core) {
+    if (core >= 0) {
+        pin_thread({core});
+    }
+
+    int idle = 0;
+    size_t next = 0;
+    while (this->running.load(std::memory_order_relaxed)) {
+        size_t end = this->ring.available(MAX_BATCH);
+        if (end != next) {
+            // Run the whole published batch, then free its slots in one go
+            for (; next != end; next++) {
+                Command& command = this->ring[next];
+                this->latency.record(now_ns() - command.enqueued);
+                command.job->invoke(command.job->context);
+                command.job->done.store(true, std::memory_order_release);
+            }
+            this->ring.release(end);
+            idle = 0;
+        } else if (!this->busy_poll && ++idle > IDLE_SPINS) {
+            // Park until a submitter sees `sleeping` and wakes us
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->sleeping.store(true);
+            this->wake.wait(guard, [this]() {
+                return !this->ring.isEmpty() || !this->running.load();
+            });
+            this->sleeping.store(false);
+            idle = 0;
+        }
+    }
+}
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.hpp"
+
+static void fail(const std::string& what) {
+    throw std::runtime_error("snapshot: " + what + ": " + std::strerror(errno));
+}
+
+// Buffers output and writes it out in large chunks
+class Writer {
+public:
+    Writer(int fd) : fd(fd), written(0) {}
+
+    void put(const void* data, size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+        this->buffer.insert(this->buffer.end(), bytes, bytes + length);
+        this->written += length;
+        if (this->buffer.size() >= (1 << 20)) {
+            this->flush();
+        }
+    }
+
+    void pad() {
+        static const char zeros[8] = {};
+        this->put(zeros, (8 - this->written % 8) % 8);
+    }
+
+    void flush() {
+        size_t done = 0;
+        while (done < this->buffer.size()) {
+            ssize_t n = ::write(this->fd, this->buffer.data() + done, this->buffer.size() - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                fail("write");
+            }
+            done += n;
+        }
+        this->buffer.clear();
+    }
+
+private:
+    int fd;
+    size_t written;
+    std::vector<char> buffer;
+};
+
+// Resting orders of a copied book in the order they were queued
+static std::vector<Order> get_orders(const BookImage& book) {
+    std::vector<Order> orders;
+    for (uint32_t head : book.heads) {
+        for (uint32_t node = head; node != NIL; node = book.nodes[node].next) {
+            orders.push_back(book.nodes[node].order);
+        }
+    }
+    return orders;
+}
+
+static void put_string(Writer& out, const std::string& s) {
+    uint32_t length = s.size();
+    out.put(&length, sizeof(length));
+    out.put(s.data(), s.size());
+}
+
+// Writes to a temporary file and renames it into place, so `path` is either the old
+// snapshot or a complete new one
+void write_snapshot(const std::string& path, SnapshotImage& image) {
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fail("open " + tmp);
+    }
+
+    image.header.magic = SNAPSHOT_MAGIC;
+    image.header.users = image.users.size();
+    image.header.assets = image.assets.size();
+    image.header.books = image.books.size();
+    image.header.size = sizeof(SnapshotHeader);
+    for (const auto& [name, callback] : image.users) {
+        image.header.size += 2 * sizeof(uint32_t) + name.size() + callback.size();
+    }
+    for (const std::string& asset : image.assets) {
+        image.header.size += sizeof(uint32_t) + asset.size();
+    }
+    image.header.size = (image.header.size + 7) & ~uint64_t(7);
+    std::vector<std::vector<Order>> orders;
+    for (BookImage& book : image.books) {
+        orders.push_back(get_orders(book));
+        std::vector<ListNode>().swap(book.nodes);
+        book.state.orders = orders.back().size();
+        image.header.size += sizeof(BookState) + book.state.orders * sizeof(Order);
+    }
+
+    Writer out(fd);
+    out.put(&image.header, sizeof(image.header));
+    for (const auto& [name, callback] : image.users) {
+        uint32_t lengths[2] = {static_cast<uint32_t>(name.size()), static_cast<uint32_t>(callback.size())};
+        out.put(lengths, sizeof(lengths));
+        out.put(name.data(), name.size());
+        out.put(callback.data(), callback.size());
+    }
+    for (const std::string& asset : image.assets) {
+        put_string(out, asset);
+    }
+    out.pad();
+    for (size_t i = 0; i < image.books.size(); i++) {
+        out.put(&image.books[i].state, sizeof(BookState));
+        out.put(orders[i].data(), orders[i].size() * sizeof(Order));
+    }
+    out.flush();
+    if (::fsync(fd) < 0) {
+        ::close(fd);
+        fail("fsync " + tmp);
+    }
+    ::close(fd);
+    if (std::rename(tmp.c_str(), path.c_str()) < 0) {
+        fail("rename " + tmp);
+    }
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    int dir = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+        ::fsync(dir);
+        ::close(dir);
+    }
+}
+
+// Snapshots are named after the journal seq they cover, zero-padded so they sort in order
+std::string snapshot_path(const std::string& directory, uint64_t seq) {
+    std::string digits = std::to_string(seq);
+    return directory + "/" + std::string(20 - digits.size(), '0') + digits + ".snapshot";
+}
+
+static std::vector<std::string> list_snapshots(const std::string& directory) {
+    std::vector<std::string> snapshots;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".snapshot") {
+            snapshots.push_back(entry.path().string());
+        }
+    }
+    std::sort(snapshots.begin(), snapshots.end());
+    return snapshots;
+}
+
+// Path of the newest snapshot in `directory`, or an empty string if there is none
+std::string find_snapshot(const std::string& directory) {
+    std::vector<std::string> snapshots = list_snapshots(directory);
+    return snapshots.empty() ? "" : snapshots.back();
+}
+
+// Deletes every snapshot in `directory` older than `keep`
+void remove_snapshots(const std::string& directory, const std::string& keep) {
+    for (const std::string& path : list_snapshots(directory)) {
+        if (path < keep) {
+            std::filesystem::remove(path);
+        }
+    }
+}
+
+// Maps the file and indexes it; orders are left in the mapping rather than copied
+SnapshotFile::SnapshotFile(const std::string& path) : mapping(MAP_FAILED), size(0) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fail("open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        ::close(fd);
+        fail("stat " + path);
+    }
+    this->size = st.st_size;
+    if (this->size >= sizeof(SnapshotHeader)) {
+        this->mapping = ::mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (this->mapping == MAP_FAILED) {
+        throw std::runtime_error("snapshot: " + path + " is not a snapshot");
+    }
+    ::madvise(this->mapping, this->size, MADV_SEQUENTIAL);
+
+    const char* data = static_cast<const char*>(this->mapping);
+    std::memcpy(&this->header, data, sizeof(this->header));
+    if (this->header.magic != SNAPSHOT_MAGIC || this->header.size != this->size) {
+        ::munmap(this->mapping, this->size);
+        throw std::runtime_error("snapshot: " + path + " is truncated or not a snapshot");
+    }
+
+    // Sizes were checked against the file as a whole, so reads past the end mean corruption
+    size_t offset = sizeof(this->header);
+    auto take = [&](void* out, size_t length) {
+        if (offset + length > this->size) {
+            ::munmap(this->mapping, this->size);
+            throw std::runtime_error("snapshot: " + path + " is corrupt");
+        }
+        if (out) {
+            std::memcpy(out, data + offset, length);
+        }
+        offset += length;
+        return data + offset - length;
+    };
+    for (uint32_t i = 0; i < this->header.users; i++) {
+        uint32_t lengths[2];
+        take(lengths, sizeof(lengths));
+        const char* name = take(nullptr, lengths[0]);
+        const char* callback = take(nullptr, lengths[1]);
+        this->users.emplace_back(std::string(name, lengths[0]), std::string(callback, lengths[1]));
+    }
+    for (uint32_t i = 0; i < this->header.assets; i++) {
+        uint32_t length;
+        take(&length, sizeof(length));
+        this->assets.emplace_back(take(nullptr, length), length);
+    }
+    offset = (offset + 7) & ~size_t(7);
+    for (uint32_t i = 0; i < this->header.books; i++) {
+        BookView book;
+        take(&book.state, sizeof(book.state));
+        book.orders = reinterpret_cast<const Order*>(take(nullptr, book.state.orders * sizeof(Order)));
+        this->books.push_back(book);
+    }
+}
+
+SnapshotFile::~SnapshotFile() {
+    ::munmap(this->mapping, this->size);
+}
+
+const SnapshotHeader& SnapshotFile::get_header() {
+    return this->header;
+}
+
+const std::vector<std::pair<std::string, std::string>>& SnapshotFile::get_users() {
+    return this->users;
+}
+
+const std::vector<std::string>& SnapshotFile::get_assets() {
+    return this->assets;
+}
+
+const std::vector<BookView>& SnapshotFile::get_books() {
+    return this->books;
+}
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""
+this script tests modifying resting orders.
+it starts the orderbook server from ../build/orderbook, rests two bids at one price and shrinks the
+first, which must keep its place ahead of the second, then grows one (sending it to the back of the
+line), re-prices one through the spread so it fills, and modifies orders that are gone or off the book's tick.
+"""
+
+import subprocess
+import time
+
+import requests
+
+BASE_URL = "http://localhost:18080"
+
+def start_orderbook_server(port=18080):
+    proc = subprocess.Popen(["../build/orderbook", "--port", str(port)],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    time.sleep(2)
+    return proc
+
+def post(path):
+    r = requests.post(f"{BASE_URL}{path}")
+    print(f"POST {path}: status={r.status_code}, response={r.text}")
+    return r
+
+def main():
+    proc = start_orderbook_server()
+
+    try:
+        post("/user/maker/http://localhost:1/maker")
+        post("/user/taker/http://localhost:1/taker")
+        post("/books/BTC/100/200/dense/5")
+
+        first = post("/limit/maker/buy/BTC/10/150").json()["order_id"]
+        second = post("/limit/maker/buy/BTC/10/150").json()["order_id"]
+
+        # a smaller size at the same price is changed in place and keeps the order first in line
+        r = post(f"/modify/{first}/4/150")
+        assert r.status_code == 200
+        assert r.json()["order_id"] == first
+        assert r.json()["quantity"] == 4
+        assert r.json()["fills"] == []
+        assert requests.get(f"{BASE_URL}/depth/BTC/1").json()["bids"] == [[150, 14]]
+        post("/limit/taker/sell/BTC/4/150")
+        assert post(f"/cancel/{first}").status_code == 204  # filled first, ahead of the larger second
+
+        # a larger size goes to the back of the level behind a newer order
+        third = post("/limit/maker/buy/BTC/3/150").json()["order_id"]
+        assert post(f"/modify/{second}/12/150").status_code == 200
+        post("/limit/taker/sell/BTC/3/150")
+        assert post(f"/cancel/{third}").status_code == 204
+        assert requests.get(f"{BASE_URL}/depth/BTC/1").json()["bids"] == [[150, 12]]
+
+        # a new price that crosses matches in the same step, at the maker's price
+        post("/limit/taker/sell/BTC/5/160")
+        r = post(f"/modify/{second}/12/165")
+        assert r.status_code == 200
+        assert r.json()["fills"] == [{"price": 160, "quantity": 5}]
+        depth = requests.get(f"{BASE_URL}/depth/BTC/1").json()
+        assert depth["bids"] == [[165, 7]]
+        assert depth["asks"] == []
+
+        r = post(f"/modify/{second}/7/163")
+        assert r.status_code == 400
+        assert r.json()["message"] == "price is not a multiple of the tick size"
+        assert post(f"/modify/{second}/7/300").status_code == 400
+        assert post(f"/modify/{first}/1/150").status_code == 204
+
+        # a quantity of 0 takes the order off the book
+        assert post(f"/modify/{second}/0/165").status_code == 200
+        assert requests.get(f"{BASE_URL}/depth/BTC/1").json()["bids"] == []
+        assert post(f"/cancel/{second}").status_code == 204
+
+    finally:
+        requests.post(f"{BASE_URL}/shutdown")
+        proc.terminate()
+        proc.wait()
+        print("test complete.")
+
+if __name__ == "__main__":
+    main()
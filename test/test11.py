@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""
+this script tests mass cancels.
+it starts the orderbook server from ../build/orderbook, rests orders for two users across two books,
+pulls one user's orders from one book and then from every book, and checks the other user's
+orders are untouched throughout.
+"""
+
+import subprocess
+import time
+
+import requests
+
+BASE_URL = "http://localhost:18080"
+
+def start_orderbook_server(port=18080):
+    proc = subprocess.Popen(["../build/orderbook", "--port", str(port)],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    time.sleep(2)
+    return proc
+
+def post(path):
+    r = requests.post(f"{BASE_URL}{path}")
+    print(f"POST {path}: status={r.status_code}, response={r.text}")
+    return r
+
+def depth(asset):
+    book = requests.get(f"{BASE_URL}/depth/{asset}/10").json()
+    return book["bids"], book["asks"]
+
+def main():
+    proc = start_orderbook_server()
+
+    try:
+        post("/user/maker/http://localhost:1/maker")
+        post("/user/other/http://localhost:1/other")
+        post("/books/BTC/100/200")
+        post("/books/ETH/10/20")
+
+        btc = [post(f"/limit/maker/buy/BTC/5/{140 + i}").json()["order_id"] for i in range(3)]
+        btc.append(post("/limit/maker/sell/BTC/5/160").json()["order_id"])
+        eth = [post(f"/limit/maker/sell/ETH/2/{15 + i}").json()["order_id"] for i in range(2)]
+        post("/limit/other/buy/BTC/7/141")
+        post("/limit/other/sell/ETH/3/16")
+
+        r = post("/cancel_all/maker/BTC")
+        assert r.status_code == 200
+        assert r.json()["cancelled"] == 4
+        assert sorted(r.json()["order_ids"]) == sorted(btc)
+        assert depth("BTC") == ([[141, 7]], [])
+        assert depth("ETH") == ([], [[15, 2], [16, 5]])
+
+        r = post("/cancel_all/maker")
+        assert r.status_code == 200
+        assert sorted(r.json()["order_ids"]) == sorted(eth)
+        assert depth("ETH") == ([], [[16, 3]])
+        assert post(f"/cancel/{eth[0]}").status_code == 204
+
+        # nothing left to cancel is not an error
+        r = post("/cancel_all/maker")
+        assert r.status_code == 200
+        assert r.json()["cancelled"] == 0
+
+        assert post("/cancel_all/nobody").status_code == 404
+        assert post("/cancel_all/maker/DOGE").status_code == 404
+        assert depth("BTC") == ([[141, 7]], [])
+
+    finally:
+        requests.post(f"{BASE_URL}/shutdown")
+        proc.terminate()
+        proc.wait()
+        print("test complete.")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""
+this script tests running out of order ids.
+it starts the orderbook server from ../build/orderbook with a fresh journal directory, takes a snapshot,
+and restarts it from that snapshot with its order id counter moved to just below the largest id a book
+can hold. the last ids must still rest, cancel and fill, and orders after them must be refused rather
+than take the server down.
+"""
+
+import glob
+import os
+import shutil
+import struct
+import subprocess
+import tempfile
+import time
+
+import requests
+
+BASE_URL = "http://localhost:18080"
+MAX_ID = 2**48 - 1  # largest order id a book can hold
+NEXT_ORDER = 40  # offset of next_order in the snapshot header
+
+def start_orderbook_server(journal, port=18080):
+    proc = subprocess.Popen(["../build/orderbook", "--port", str(port), "--journal", journal, "--durability", "sync"],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    time.sleep(2)
+    return proc
+
+def post(path):
+    r = requests.post(f"{BASE_URL}{path}")
+    print(f"POST {path}: status={r.status_code}, response={r.text}")
+    return r
+
+def main():
+    journal = tempfile.mkdtemp(prefix="orderbook_journal_")
+    proc = start_orderbook_server(journal)
+
+    try:
+        post("/user/maker/http://localhost:1/maker")
+        post("/user/taker/http://localhost:1/taker")
+        post("/books/BTC/100/200")
+        assert post("/snapshot").status_code == 200
+        requests.post(f"{BASE_URL}/shutdown")
+        proc.wait()
+
+        # the restart takes the counter from the newest snapshot, as nothing after it placed an order
+        path = sorted(glob.glob(os.path.join(journal, "*.snapshot")))[-1]
+        with open(path, "r+b") as snapshot:
+            snapshot.seek(NEXT_ORDER)
+            snapshot.write(struct.pack("<Q", MAX_ID - 1))
+        proc = start_orderbook_server(journal)
+
+        r = post("/limit/maker/sell/BTC/5/150")
+        assert r.status_code == 200 and r.json()["order_id"] == MAX_ID - 1
+        r = post("/limit/maker/sell/BTC/7/151")
+        assert r.status_code == 200 and r.json()["order_id"] == MAX_ID
+
+        r = post("/limit/maker/sell/BTC/1/152")
+        assert r.status_code == 503
+        assert r.json()["message"] == "order ids are exhausted"
+        r = requests.post(f"{BASE_URL}/batch", json={"user": "taker", "commands": [
+            {"type": "market", "direction": "buy", "asset": "BTC", "quantity": 1},
+            {"type": "cancel", "order_id": MAX_ID},
+        ]})
+        results = r.json()["results"]
+        assert results[0] == {"status": 503, "message": "order ids are exhausted"}
+        assert results[1]["status"] == 200 and results[1]["quantity"] == 7
+
+        # the book still works for what rests in it
+        assert requests.get(f"{BASE_URL}/depth/BTC/2").json()["asks"] == [[150, 5]]
+        assert post(f"/modify/{MAX_ID - 1}/3/150").status_code == 200
+        assert requests.get(f"{BASE_URL}/depth/BTC/2").json()["asks"] == [[150, 3]]
+
+    finally:
+        requests.post(f"{BASE_URL}/shutdown")
+        proc.terminate()
+        proc.wait()
+        shutil.rmtree(journal, ignore_errors=True)
+        print("test complete.")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""
+this script tests asynchronous fill notifications.
+it starts the orderbook server from ../build/orderbook and a stand-in callback receiver on port 18081.
+a sweep across many price levels should return immediately even when the taker's callback is slow,
+and every fill should still reach each user, with bursts of fills coalesced into fewer posts.
+"""
+
+import json
+import subprocess
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+import requests
+
+BASE_URL = "http://localhost:18080"
+LEVELS = 50
+
+# list of (path, fills) for each callback post received
+callback_posts = []
+callback_lock = threading.Lock()
+
+class CallbackHandler(BaseHTTPRequestHandler):
+    def do_POST(self):
+        content_length = int(self.headers.get('Content-Length', 0))
+        data = json.loads(self.rfile.read(content_length))
+        fills = data if isinstance(data, list) else [data]
+        # simulate a user whose endpoint is slow to answer, though inside the notifier's 1s timeout
+        # so its posts aren't retried and delivered twice
+        if self.path.startswith("/slow"):
+            time.sleep(0.5)
+        with callback_lock:
+            callback_posts.append((self.path, fills))
+        self.send_response(200)
+        self.end_headers()
+
+    def log_message(self, format, *args):
+        return
+
+def run_callback_server(port=18081):
+    httpd = ThreadingHTTPServer(('', port), CallbackHandler)
+    httpd.serve_forever()
+
+def start_orderbook_server(port=18080):
+    proc = subprocess.Popen(["../build/orderbook", "--port", str(port)],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    time.sleep(2)
+    return proc
+
+def fills_for(path):
+    with callback_lock:
+        return [fill for p, fills in callback_posts if p == path for fill in fills]
+
+def posts_for(path):
+    with callback_lock:
+        return len([p for p, _ in callback_posts if p == path])
+
+def main():
+    threading.Thread(target=run_callback_server, args=(18081,), daemon=True).start()
+    proc = start_orderbook_server()
+
+    try:
+        requests.post(f"{BASE_URL}/user/maker/http://localhost:18081/maker")
+        requests.post(f"{BASE_URL}/user/taker/http://localhost:18081/slow")
+        requests.post(f"{BASE_URL}/user/ghost/http://localhost:1/dead")
+        requests.post(f"{BASE_URL}/books/BTC/100/200")
+
+        # rest one ask on each of LEVELS levels
+        for i in range(LEVELS):
+            r = requests.post(f"{BASE_URL}/limit/maker/sell/BTC/1/{100 + i}")
+            assert r.status_code == 200
+
+        # sweep them all; the taker's slow endpoint must not hold up the response
+        start = time.time()
+        r = requests.post(f"{BASE_URL}/limit/taker/buy/BTC/{LEVELS}/200")
+        elapsed = time.time() - start
+        print(f"sweep of {LEVELS} levels answered in {elapsed * 1000:.1f} ms")
+        assert r.status_code == 200
+        assert elapsed < 0.25
+
+        # a user whose callback is unreachable must not block anyone either
+        requests.post(f"{BASE_URL}/limit/ghost/sell/BTC/1/150")
+        start = time.time()
+        r = requests.post(f"{BASE_URL}/limit/maker/buy/BTC/1/150")
+        assert r.status_code == 200
+        assert time.time() - start < 1
+
+        # wait for delivery
+        deadline = time.time() + 10
+        while time.time() < deadline and len(fills_for("/slow")) < LEVELS:
+            time.sleep(0.1)
+
+        maker_fills = fills_for("/maker")
+        taker_fills = fills_for("/slow")
+        print(f"maker received {len(maker_fills)} fills in {posts_for('/maker')} posts")
+        print(f"taker received {len(taker_fills)} fills in {posts_for('/slow')} posts")
+        assert len(maker_fills) == LEVELS + 1
+        assert len(taker_fills) == LEVELS
+        assert sorted(f["price"] for f in taker_fills) == list(range(100, 100 + LEVELS))
+        assert posts_for("/slow") < LEVELS
+
+        stats = requests.get(f"{BASE_URL}/notifier").json()
+        print(f"notifier stats: {stats}")
+        assert stats["failed"] == 1
+        assert stats["dropped"] == 0
+
+    finally:
+        requests.post(f"{BASE_URL}/shutdown")
+        proc.terminate()
+        proc.wait()
+        print("test complete.")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+this script tests the batch order-entry endpoint.
+it starts the orderbook server from ../build/orderbook, quotes a ladder of asks and a bid in one
+POST /batch, then sends a second batch mixing a market order, cancels and bad commands.
+results must come back in submission order and leave the book as if each command had been sent alone.
+"""
+
+import subprocess
+import time
+
+import requests
+
+BASE_URL = "http://localhost:18080"
+
+def start_orderbook_server(port=18080):
+    proc = subprocess.Popen(["../build/orderbook", "--port", str(port)],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    time.sleep(2)
+    return proc
+
+def batch(user, commands):
+    r = requests.post(f"{BASE_URL}/batch", json={"user": user, "commands": commands})
+    print(f"batch of {len(commands)} by {user}: status={r.status_code}, response={r.text}")
+    return r
+
+def main():
+    proc = start_orderbook_server()
+
+    try:
+        requests.post(f"{BASE_URL}/user/maker/http://localhost:1/maker")
+        requests.post(f"{BASE_URL}/user/taker/http://localhost:1/taker")
+        requests.post(f"{BASE_URL}/books/BTC/100/200")
+        requests.post(f"{BASE_URL}/books/ETH/10/20")
+
+        # quote five asks and one bid in a single request
+        quotes = [{"type": "limit", "direction": "sell", "asset": "BTC", "quantity": 2, "price": 150 + i} for i in range(5)]
+        quotes.append({"type": "limit", "direction": "buy", "asset": "ETH", "quantity": 7, "price": 15})
+        r = batch("maker", quotes)
+        assert r.status_code == 200
+        results = r.json()["results"]
+        assert [res["status"] for res in results] == [200] * 6
+        ids = [res["order_id"] for res in results]
+        assert ids == sorted(ids)
+
+        r = batch("taker", [
+            {"type": "market", "direction": "buy", "asset": "BTC", "quantity": 5},
+            {"type": "cancel", "order_id": ids[4]},
+            {"type": "cancel", "order_id": ids[4]},
+            {"type": "limit", "direction": "buy", "asset": "BTC", "quantity": 1, "price": 300},
+            {"type": "limit", "direction": "buy", "asset": "DOGE", "quantity": 1, "price": 1},
+            {"type": "limit", "direction": "up", "asset": "BTC", "quantity": 1, "price": 150},
+            {"type": "limit", "direction": "sell", "asset": "ETH", "quantity": 3, "price": 15},
+        ])
+        assert r.status_code == 200
+        results = r.json()["results"]
+        assert [res["status"] for res in results] == [200, 200, 204, 400, 404, 404, 200]
+        assert [(f["price"], f["quantity"]) for f in results[0]["fills"]] == [(150, 2), (151, 2), (152, 1)]
+        assert results[1]["price"] == 154 and results[1]["quantity"] == 2
+        assert [(f["price"], f["quantity"]) for f in results[6]["fills"]] == [(15, 3)]
+
+        # the book should look like the commands were sent one by one
+        assert requests.get(f"{BASE_URL}/orders/sell/BTC/200").json() == {"152": 1}
+        # only the touch is reported, so take it to see the level behind
+        assert requests.post(f"{BASE_URL}/limit/taker/buy/BTC/1/152").status_code == 200
+        assert requests.get(f"{BASE_URL}/orders/sell/BTC/200").json() == {"153": 2}
+        assert requests.get(f"{BASE_URL}/orders/buy/ETH/10").json() == {"15": 4}
+
+        # a batch is rejected as a whole for an unknown user or an unreadable body
+        assert batch("nobody", quotes).status_code == 401
+        assert requests.post(f"{BASE_URL}/batch", data="not json").status_code == 400
+        assert batch("maker", [{"type": "limit", "direction": "buy"}]).status_code == 400
+
+    finally:
+        requests.post(f"{BASE_URL}/shutdown")
+        proc.terminate()
+        proc.wait()
+        print("test complete.")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""
+this script tests recovery from the journal and snapshots.
+it starts the orderbook server from ../build/orderbook with a fresh journal directory, registers users,
+adds a book and rests some orders, takes a snapshot, then partially fills and cancels orders and kills the
+server without a clean shutdown. after a restart on the same journal (loading the snapshot and replaying
+what came after it) the book, users and order ids must pick up where they left off.
+"""
+
+import shutil
+import subprocess
+import tempfile
+import time
+
+import requests
+
+BASE_URL = "http://localhost:18080"
+
+def start_orderbook_server(journal, port=18080):
+    proc = subprocess.Popen(["../build/orderbook", "--port", str(port), "--journal", journal, "--durability", "sync"],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    time.sleep(2)
+    return proc
+
+def book(side, price):
+    return requests.get(f"{BASE_URL}/orders/{side}/BTC/{price}").json()
+
+def main():
+    journal = tempfile.mkdtemp(prefix="orderbook_journal_")
+    proc = start_orderbook_server(journal)
+
+    try:
+        requests.post(f"{BASE_URL}/user/maker/http://localhost:1/maker")
+        requests.post(f"{BASE_URL}/user/taker/http://localhost:1/taker")
+        requests.post(f"{BASE_URL}/books/BTC/100/200")
+
+        requests.post(f"{BASE_URL}/limit/maker/sell/BTC/5/150")
+        requests.post(f"{BASE_URL}/limit/maker/sell/BTC/7/150")
+        requests.post(f"{BASE_URL}/limit/maker/buy/BTC/4/120")
+        r = requests.post(f"{BASE_URL}/snapshot")
+        print(f"snapshot: {r.json()}")
+        assert r.status_code == 200
+        cancelled = requests.post(f"{BASE_URL}/limit/maker/buy/BTC/9/130").json()["order_id"]
+        requests.post(f"{BASE_URL}/cancel/{cancelled}")
+        last = requests.post(f"{BASE_URL}/limit/taker/buy/BTC/8/150").json()["order_id"]
+
+        before = (book("sell", 150), book("buy", 120))
+        print(f"before restart: {before}")
+        assert before == ({"150": 4}, {"120": 4})
+
+        # no shutdown request: the journal has to hold up to the process dying
+        proc.kill()
+        proc.wait()
+        proc = start_orderbook_server(journal)
+
+        after = (book("sell", 150), book("buy", 120))
+        print(f"after restart: {after}")
+        assert after == before
+
+        # the registered taker can keep trading, the remaining maker order fills first and ids move on
+        r = requests.post(f"{BASE_URL}/limit/taker/buy/BTC/4/150")
+        assert r.status_code == 200
+        assert r.json()["order_id"] == last + 1
+        assert book("sell", 150) is None  # the server answers null once the level is gone
+
+    finally:
+        requests.post(f"{BASE_URL}/shutdown")
+        proc.terminate()
+        proc.wait()
+        shutil.rmtree(journal)
+        print("test complete.")
+
+if __name__ == "__main__":
+    main()
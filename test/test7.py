@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+this script tests the market data feed.
+it starts the orderbook server from ../build/orderbook, follows BTC over the /feed websocket and
+keeps a local copy of the book from the book and delta messages while orders are placed, filled
+and cancelled over REST. the local copy must end up holding every level the book should have.
+"""
+
+import json
+import subprocess
+import time
+
+import requests
+import websocket
+
+BASE_URL = "http://localhost:18080"
+FEED_URL = "ws://localhost:18080/feed"
+
+def start_orderbook_server(port=18080):
+    proc = subprocess.Popen(["../build/orderbook", "--port", str(port), "--feed-refresh", "1"],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    time.sleep(2)
+    return proc
+
+class LocalBook:
+    def __init__(self):
+        self.seq = None
+        self.levels = {}
+        self.books = 0
+
+    def apply(self, message):
+        if message["type"] == "book":
+            if message["seq"] == self.seq:
+                # same point in the book's history, so the deltas must have built the same levels
+                levels = {price: (side, qty) for side, price, qty in message["levels"]}
+                assert levels == self.levels, f"deltas built {self.levels}, book is {levels}"
+            self.seq = message["seq"]
+            self.levels = {price: (side, qty) for side, price, qty in message["levels"]}
+            self.books += 1
+            return
+        assert message["type"] == "delta"
+        if self.seq is None or message["seq"] <= self.seq:
+            return
+        assert message["seq"] == self.seq + 1, f"gap after {self.seq}: {message}"
+        self.seq = message["seq"]
+        for side, price, qty in message["levels"]:
+            if qty == 0:
+                self.levels.pop(price, None)
+            else:
+                self.levels[price] = (side, qty)
+
+    def side(self, side):
+        return {str(price): qty for price, (s, qty) in self.levels.items() if s == side}
+
+def drain(ws, book, seconds):
+    ws.settimeout(0.1)
+    end = time.time() + seconds
+    while time.time() < end:
+        try:
+            frame = ws.recv()
+        except websocket.WebSocketTimeoutException:
+            continue
+        for message in json.loads(frame):
+            book.apply(message)
+
+def main():
+    proc = start_orderbook_server()
+
+    try:
+        requests.post(f"{BASE_URL}/user/maker/http://localhost:1/maker")
+        requests.post(f"{BASE_URL}/user/taker/http://localhost:1/taker")
+        requests.post(f"{BASE_URL}/books/BTC/100/200")
+        requests.post(f"{BASE_URL}/limit/maker/buy/BTC/5/140")
+
+        ws = websocket.create_connection(FEED_URL)
+        ws.send("DOGE")
+        assert json.loads(ws.recv())[0]["type"] == "error"
+        ws.send("BTC")
+        book = LocalBook()
+        drain(ws, book, 0.5)
+        # a refresh may land in the same half second as the book sent on subscribe
+        assert book.books >= 1 and book.side("buy") == {"140": 5}
+
+        ids = []
+        for i in range(5):
+            r = requests.post(f"{BASE_URL}/limit/maker/sell/BTC/{3 + i}/{150 + i}")
+            ids.append(r.json()["order_id"])
+            requests.post(f"{BASE_URL}/limit/maker/buy/BTC/{2 + i}/{145 - i}")
+        requests.post(f"{BASE_URL}/market/taker/buy/BTC/9")
+        requests.post(f"{BASE_URL}/limit/taker/sell/BTC/4/141")
+        requests.post(f"{BASE_URL}/cancel/{ids[4]}")
+        drain(ws, book, 0.5)
+
+        # the market buy takes 150, 151 and part of 152, the sell takes 145 and part of 144,
+        # and the cancel empties 154
+        expected_buy = {"144": 1, "143": 4, "142": 5, "141": 6, "140": 5}
+        expected_sell = {"152": 3, "153": 6}
+        print(f"local book: {book.levels}")
+        assert requests.get(f"{BASE_URL}/orders/buy/BTC/100").json() == {"144": 1}
+        assert requests.get(f"{BASE_URL}/orders/sell/BTC/200").json() == {"152": 3}
+        assert book.side("buy") == expected_buy
+        assert book.side("sell") == expected_sell
+        drain(ws, book, 1.5)
+        assert book.books >= 2
+        assert book.side("buy") == expected_buy
+        assert book.side("sell") == expected_sell
+
+        # a buy that takes out the whole 152 ask and rests the rest at 152 moves the level to the
+        # buy side, so its deltas must clear it as a sell and set it as a buy
+        requests.post(f"{BASE_URL}/limit/taker/buy/BTC/5/152")
+        drain(ws, book, 0.5)
+        expected_buy["152"] = 2
+        del expected_sell["152"]
+        assert requests.get(f"{BASE_URL}/orders/buy/BTC/100").json() == {"152": 2}
+        assert book.side("buy") == expected_buy
+        assert book.side("sell") == expected_sell
+        drain(ws, book, 1.5)
+        assert book.side("buy") == expected_buy
+        assert book.side("sell") == expected_sell
+        ws.close()
+
+    finally:
+        requests.post(f"{BASE_URL}/shutdown")
+        proc.terminate()
+        proc.wait()
+        print("test complete.")
+
+if __name__ == "__main__":
+    main()
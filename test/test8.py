@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""
+this script tests the depth endpoint.
+it starts the orderbook server from ../build/orderbook with a depth limit of 3, builds a small book
+and checks GET /depth returns the best levels of each side in order, keeps its version while the
+top of the book is untouched and moves it once the top changes.
+"""
+
+import subprocess
+import time
+
+import requests
+
+BASE_URL = "http://localhost:18080"
+
+def start_orderbook_server(port=18080):
+    proc = subprocess.Popen(["../build/orderbook", "--port", str(port), "--depth", "3"],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    time.sleep(2)
+    return proc
+
+def depth(asset, levels):
+    r = requests.get(f"{BASE_URL}/depth/{asset}/{levels}")
+    print(f"depth {asset} {levels}: status={r.status_code}, response={r.text}")
+    return r
+
+def main():
+    proc = start_orderbook_server()
+
+    try:
+        requests.post(f"{BASE_URL}/user/maker/http://localhost:1/maker")
+        requests.post(f"{BASE_URL}/books/BTC/100/200")
+        for i in range(5):
+            requests.post(f"{BASE_URL}/limit/maker/buy/BTC/{1 + i}/{140 - i}")
+            requests.post(f"{BASE_URL}/limit/maker/sell/BTC/{1 + i}/{150 + i}")
+
+        r = depth("BTC", 3)
+        assert r.status_code == 200
+        book = r.json()
+        assert book["bids"] == [[140, 1], [139, 2], [138, 3]]
+        assert book["asks"] == [[150, 1], [151, 2], [152, 3]]
+        assert depth("BTC", 1).json()["bids"] == [[140, 1]]
+
+        # a change below the top three levels leaves the view, and its version, alone
+        requests.post(f"{BASE_URL}/limit/maker/buy/BTC/7/110")
+        assert depth("BTC", 3).json() == book
+
+        # a change at the top moves it
+        requests.post(f"{BASE_URL}/limit/maker/buy/BTC/4/145")
+        after = depth("BTC", 3).json()
+        assert after["version"] != book["version"]
+        assert after["bids"] == [[145, 4], [140, 1], [139, 2]]
+
+        assert depth("BTC", 4).status_code == 400
+        assert depth("BTC", 0).status_code == 400
+        assert depth("DOGE", 1).status_code == 404
+
+    finally:
+        requests.post(f"{BASE_URL}/shutdown")
+        proc.terminate()
+        proc.wait()
+        print("test complete.")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""
+this script tests tick sizes and 64-bit quantities.
+it starts the orderbook server from ../build/orderbook, adds a book with a tick size of 5 and checks
+limit prices off the tick are refused while market orders and prices on it go through, then rests
+and fills a quantity past the 32-bit range. last it checks the cap on one order's quantity, and that
+a side whose depth can't take an order any more refuses it.
+"""
+
+import subprocess
+import time
+
+import requests
+
+BASE_URL = "http://localhost:18080"
+BIG = 5_000_000_000  # more than fits in 32 bits
+MAX_QUANTITY = 2**53 - 1  # largest one order may be
+
+def start_orderbook_server(port=18080):
+    proc = subprocess.Popen(["../build/orderbook", "--port", str(port)],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    time.sleep(2)
+    return proc
+
+def post(path):
+    r = requests.post(f"{BASE_URL}{path}")
+    print(f"POST {path}: status={r.status_code}, response={r.text}")
+    return r
+
+def main():
+    proc = start_orderbook_server()
+
+    try:
+        post("/user/maker/http://localhost:1/maker")
+        post("/user/taker/http://localhost:1/taker")
+        assert post("/books/BTC/100/200/dense/0").status_code == 400
+        assert post("/books/BTC/100/200/dense/5").status_code == 200
+
+        r = post("/limit/maker/sell/BTC/10/152")
+        assert r.status_code == 400
+        assert r.json()["message"] == "price is not a multiple of the tick size"
+        assert post("/limit/maker/sell/BTC/10/155").status_code == 200
+
+        # orders take the maker's price whatever their own limit, so a market order needs no tick
+        assert post("/market/taker/buy/BTC/4").status_code == 200
+        assert requests.get(f"{BASE_URL}/depth/BTC/1").json()["asks"] == [[155, 6]]
+
+        assert post(f"/limit/maker/buy/BTC/{BIG}/150").status_code == 200
+        assert requests.get(f"{BASE_URL}/depth/BTC/1").json()["bids"] == [[150, BIG]]
+        r = post(f"/limit/taker/sell/BTC/{BIG - 1}/150")
+        assert r.status_code == 200
+        assert requests.get(f"{BASE_URL}/depth/BTC/1").json()["bids"] == [[150, 1]]
+        assert requests.get(f"{BASE_URL}/orders/buy/BTC/-9999999999").json() == {"150": 1}
+
+        r = requests.post(f"{BASE_URL}/batch", json={"user": "taker", "commands": [
+            {"type": "limit", "direction": "sell", "asset": "BTC", "quantity": 1, "price": 151},
+            {"type": "limit", "direction": "sell", "asset": "BTC", "quantity": 1, "price": 150},
+        ]})
+        results = r.json()["results"]
+        assert results[0]["status"] == 400
+        assert results[1]["status"] == 200
+        assert results[1]["fills"] == [{"price": 150, "quantity": 1}]
+
+        # one order may be anywhere from 1 to MAX_QUANTITY
+        assert post("/books/ETH/100/200").status_code == 200
+        for path in ["/limit/maker/buy/ETH/0/100", f"/limit/maker/buy/ETH/{MAX_QUANTITY + 1}/100", "/market/taker/sell/ETH/0"]:
+            r = post(path)
+            assert r.status_code == 400
+            assert r.json()["message"] == "quantity is out of bounds"
+        r = post(f"/limit/maker/buy/ETH/{MAX_QUANTITY}/100")
+        assert r.status_code == 200
+        assert post(f"/modify/{r.json()['order_id']}/{MAX_QUANTITY + 1}/100").status_code == 400
+
+        # 2048 of the largest orders leave the side 2047 short of wrapping, so one more that size is refused
+        r = requests.post(f"{BASE_URL}/batch", json={"user": "maker", "commands": [
+            {"type": "limit", "direction": "buy", "asset": "ETH", "quantity": MAX_QUANTITY, "price": 100}
+        ] * 2047 + [
+            {"type": "limit", "direction": "buy", "asset": "ETH", "quantity": 0, "price": 100},
+        ]})
+        results = r.json()["results"]
+        assert all(result["status"] == 200 for result in results[:2047])
+        assert results[2047] == {"status": 400, "message": "quantity is out of bounds"}
+        full = 2048 * MAX_QUANTITY
+        assert requests.get(f"{BASE_URL}/depth/ETH/1").json()["bids"] == [[100, full]]
+        r = post("/limit/maker/buy/ETH/2048/100")
+        assert r.status_code == 400
+        assert r.json()["message"] == "quantity is out of bounds"
+        r = requests.post(f"{BASE_URL}/batch", json={"user": "maker", "commands": [
+            {"type": "limit", "direction": "buy", "asset": "ETH", "quantity": 2048, "price": 100},
+            {"type": "limit", "direction": "buy", "asset": "ETH", "quantity": 2047, "price": 100},
+        ]})
+        results = r.json()["results"]
+        assert [result["status"] for result in results] == [400, 200]
+        assert requests.get(f"{BASE_URL}/depth/ETH/1").json()["bids"] == [[100, 2**64 - 1]]
+        assert post(f"/modify/{results[1]['order_id']}/2048/100").status_code == 400  # growing it would wrap too
+        assert post(f"/modify/{results[1]['order_id']}/2046/100").status_code == 200
+        assert post("/limit/maker/sell/ETH/5/105").status_code == 200  # the other side has room
+
+    finally:
+        requests.post(f"{BASE_URL}/shutdown")
+        proc.terminate()
+        proc.wait()
+        print("test complete.")
+
+if __name__ == "__main__":
+    main()